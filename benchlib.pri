@@ -1,6 +1,6 @@
 INCLUDEPATH += $$PWD/src
-HEADERS +=       $$PWD/src/database.h  $$PWD/src/reportgenerator.h 
-SOURCES +=  $$PWD/src/database.cpp  $$PWD/src/reportgenerator.cpp 
+HEADERS +=       $$PWD/src/database.h  $$PWD/src/reportgenerator.h  $$PWD/src/buildrun.h  $$PWD/src/statistics.h  $$PWD/src/changepoint.h  $$PWD/src/noisemodel.h  $$PWD/src/environment.h  $$PWD/src/processusage.h  $$PWD/src/perfcounters.h 
+SOURCES +=  $$PWD/src/database.cpp  $$PWD/src/reportgenerator.cpp  $$PWD/src/buildrun.cpp  $$PWD/src/statistics.cpp  $$PWD/src/changepoint.cpp  $$PWD/src/noisemodel.cpp  $$PWD/src/environment.cpp  $$PWD/src/processusage.cpp  $$PWD/src/perfcounters.cpp 
 
 
 CONFIG += console release
@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "adaptiverun.h"
+#include "database.h"
+#include "statistics.h"
+#include "noisemodel.h"
+
+// Returns the test functions of \a executable as listed by QTestLib's -functions option.
+QStringList testFunctions(const QString &workdir, const QString &executable)
+{
+    QProcess p;
+    if (workdir != QString())
+        p.setWorkingDirectory(workdir);
+    p.start(executable, QStringList() << "-functions");
+    if (p.waitForFinished(-1) == false)
+        return QStringList();
+
+    QStringList functions;
+    foreach (QByteArray line, p.readAllStandardOutput().split('\n')) {
+        line = line.trimmed();
+        if (line.endsWith("()"))
+            functions += QString::fromLocal8Bit(line.left(line.length() - 2));
+    }
+    return functions;
+}
+
+// The test functions of \a executable that are worth running on their own: all but
+// initTestCase and cleanupTestCase, which run along with every function anyway.
+QStringList benchmarkFunctions(const QString &workdir, const QString &executable)
+{
+    QStringList functions;
+    foreach (QString function, testFunctions(workdir, executable)) {
+        if (function != "initTestCase" && function != "cleanupTestCase")
+            functions += function;
+    }
+    return functions;
+}
+
+QString BenchmarkValue::key() const
+{
+    return noiseKey(function, tag, metric);
+}
+
+// Per iteration results of one run. The name of the test case is returned in \a testCase.
+static QList<BenchmarkValue> benchmarkValues(const QByteArray &xml, QString *testCase)
+{
+    QList<BenchmarkValue> values;
+    QXmlStreamReader reader(xml);
+    QString function;
+    while (reader.atEnd() == false) {
+        reader.readNext();
+        if (reader.isStartElement() == false)
+            continue;
+        const QXmlStreamAttributes attributes = reader.attributes();
+        if (reader.name() == "TestCase") {
+            *testCase = attributes.value("name").toString();
+        } else if (reader.name() == "TestFunction") {
+            function = attributes.value("name").toString();
+        } else if (reader.name() == "BenchmarkResult") {
+            const qreal iterations = qMax(attributes.value("iterations").toString().toDouble(), 1.0);
+            BenchmarkValue value;
+            value.function = function;
+            value.tag = attributes.value("tag").toString();
+            value.metric = attributes.value("metric").toString();
+            value.value = attributes.value("value").toString().toDouble() / iterations;
+            values += value;
+        }
+    }
+    if (reader.hasError())
+        qDebug() << "reading benchmark results failed:" << reader.errorString();
+    return values;
+}
+
+RunStatus runBenchmarkOnce(const QString &workdir, const QString &executable, const RunOptions &options,
+                           const QStringList &arguments, const QString &function, const QString &runLabel,
+                           QList<BenchmarkValue> *values)
+{
+    QTemporaryFile resultFile;
+    resultFile.open();
+    const QString resultFileName = resultFile.fileName();
+    resultFile.close();
+
+    QStringList runArguments = arguments;
+    runArguments << "-xml" << "-o" << resultFileName;
+    if (function.isEmpty() == false)
+        runArguments << function;
+
+    RunStatus status = runBenchmark(QString(), workdir, executable, options, -1, runArguments);
+    if (status.ok() == false)
+        return status;
+
+    QFile f(resultFileName);
+    f.open(QIODevice::ReadOnly);
+    const QByteArray xml = f.readAll();
+    QString testCase;
+    *values = benchmarkValues(xml, &testCase);
+    if (runLabel.isEmpty() == false) {
+        loadXml(xml, QFileInfo(executable).fileName(), runLabel);
+        if (status.usage.valid)
+            loadXml(status.usage.toXml(testCase, function), "processUsage", runLabel);
+    }
+    return status;
+}
+
+// The widest confidence interval of the median among \a samples, relative to the median.
+static qreal relativeWidth(const QHash<QString, QList<qreal> > &samples, qreal confidence)
+{
+    qreal widest = 0;
+    foreach (const QList<qreal> &values, samples) {
+        const qreal m = median(values);
+        const QPair<qreal, qreal> interval = medianConfidenceInterval(values, confidence);
+        if (m != 0)
+            widest = qMax(widest, (interval.second - interval.first) / qAbs(m));
+    }
+    return widest;
+}
+
+// One function, or the whole executable, being repeated.
+struct RunUnit
+{
+    RunUnit() : repetitions(0), width(0), converged(false) { }
+    QString function;
+    QHash<QString, QList<qreal> > samples;
+    int repetitions;
+    qreal width;
+    bool converged;
+};
+
+RunStatus runBenchmarkAdaptive(const QString &workdir, const QString &executable,
+                               const AdaptiveRunOptions &options, const QString &runLabel)
+{
+    QList<RunUnit> units;
+    const QStringList functions = options.perFunction ? benchmarkFunctions(workdir, executable) : QStringList();
+    if (functions.isEmpty()) {
+        units += RunUnit();
+    } else {
+        foreach (QString function, functions) {
+            RunUnit unit;
+            unit.function = function;
+            units += unit;
+        }
+    }
+
+    RunStatus status;
+    bool propertiesStored = false;
+    QElapsedTimer timer;
+    timer.start();
+
+    // Rounds of one repetition per unit that has not converged yet, so the budget is
+    // spent on the noisy ones.
+    bool done = false;
+    while (done == false) {
+        done = true;
+        for (int i = 0; i < units.count(); ++i) {
+            RunUnit &unit = units[i];
+            if (unit.converged || unit.repetitions >= options.maximumRepetitions)
+                continue;
+            if (timer.elapsed() > options.timeBudget && unit.repetitions >= options.minimumRepetitions)
+                continue;
+
+            QList<BenchmarkValue> values;
+            RunStatus runStatus = runBenchmarkOnce(workdir, executable, options.runOptions, options.arguments,
+                                                   unit.function, runLabel, &values);
+            if (runStatus.ok() == false)
+                return runStatus;
+            if (propertiesStored == false) {
+                if (runLabel.isEmpty() == false)
+                    addRunProperties(runLabel, runStatus.properties);
+                status.properties = runStatus.properties;
+                propertiesStored = true;
+            }
+
+            foreach (const BenchmarkValue &value, values)
+                unit.samples[value.key()] += value.value;
+            ++unit.repetitions;
+
+            unit.width = relativeWidth(unit.samples, options.confidence);
+            unit.converged = unit.repetitions >= options.minimumRepetitions && unit.width <= options.targetWidth;
+            done = false;
+        }
+    }
+
+    foreach (const RunUnit &unit, units) {
+        const QString name = unit.function.isEmpty() ? QFileInfo(executable).fileName() : unit.function;
+        status.output += QString("%1: %2 repetitions, %3 (median confidence interval %4%)\n")
+            .arg(name).arg(unit.repetitions).arg(unit.converged ? "converged" : "NOT converged")
+            .arg(unit.width * 100, 0, 'f', 2).toLocal8Bit();
+    }
+    return status;
+}
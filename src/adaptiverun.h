@@ -0,0 +1,82 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef ADAPTIVERUN_H
+#define ADAPTIVERUN_H
+
+#include <QtCore>
+#include "buildrun.h"
+
+// Options for running a benchmark repeatedly until its results have converged, i.e.
+// until the confidence interval of the median of every function/tag/metric is at most
+// targetWidth wide (relative to the median, so 0.02 means 2%). Repetitions stop early
+// when timeBudget (in milliseconds, for the whole benchmark) or maximumRepetitions is
+// reached. With perFunction, each test function is run on its own, so functions that
+// have converged are not run again while noisy ones still are. arguments are passed on
+// to every run, e.g. "-callgrind" or "-tickcounter".
+class AdaptiveRunOptions
+{
+public:
+    AdaptiveRunOptions()
+    : targetWidth(0.02), confidence(0.95), minimumRepetitions(3), maximumRepetitions(50),
+      timeBudget(10 * 60 * 1000), perFunction(true) { }
+    qreal targetWidth;
+    qreal confidence;
+    int minimumRepetitions;
+    int maximumRepetitions;
+    int timeBudget;
+    bool perFunction;
+    QStringList arguments;
+    RunOptions runOptions;
+};
+
+QStringList testFunctions(const QString &workdir, const QString &executable);
+QStringList benchmarkFunctions(const QString &workdir, const QString &executable);
+
+// One result of a run: the per iteration value of a function/tag/metric.
+class BenchmarkValue
+{
+public:
+    BenchmarkValue() : value(0) { }
+    QString function;
+    QString tag;
+    QString metric;
+    qreal value;
+    QString key() const;
+};
+
+// Runs \a executable once with -xml, restricted to \a function unless it is empty, and
+// returns its results in \a values. Unless \a runLabel is empty, the results and the
+// resource usage of the process are loaded into the open results database under it.
+RunStatus runBenchmarkOnce(const QString &workdir, const QString &executable, const RunOptions &options,
+                           const QStringList &arguments, const QString &function, const QString &runLabel,
+                           QList<BenchmarkValue> *values);
+
+// Runs the QTestLib benchmark \a executable until converged (see above) and loads the
+// results of every repetition into the open results database under \a runLabel, so each
+// repetition is a separate sample. The run properties of the first repetition are
+// stored for the run label as well. The output of the returned status summarizes the
+// repetitions and convergence per function.
+RunStatus runBenchmarkAdaptive(const QString &workdir, const QString &executable,
+                               const AdaptiveRunOptions &options, const QString &runLabel);
+
+#endif
@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "bisect.h"
+#include "database.h"
+#include "statistics.h"
+
+// The selected result of \a testCase in the runs stored under \a runLabel.
+static QList<qreal> storedValues(const BisectOptions &options, const QString &testCase, const QString &runLabel)
+{
+    const QString series = tagSeries(options.tag);
+    const QString index = tagIndex(options.tag);
+
+    QSqlQuery query;
+    query.prepare(QString("SELECT Result FROM Results WHERE RunLabel = :RunLabel AND TestName = :TestCase "
+                          "AND TestCaseName = :Function AND Metric = :Metric AND Series = :Series AND ")
+                  + (index.isEmpty() ? "(Idx IS NULL OR Idx = '')" : "Idx = :Idx"));
+    query.bindValue(":RunLabel", runLabel);
+    query.bindValue(":TestCase", testCase);
+    query.bindValue(":Function", options.function);
+    query.bindValue(":Metric", options.metric);
+    query.bindValue(":Series", series);
+    if (index.isEmpty() == false)
+        query.bindValue(":Idx", index);
+    execQuery(query);
+
+    QList<qreal> values;
+    while (query.next())
+        values += query.value(0).toDouble();
+    return values;
+}
+
+// Checks out, builds and runs the benchmark at \a commit, storing the results under
+// the run label of the commit in the session \a sessionLabel. Returns false on failure,
+// with the reason in \a error.
+static bool measureCommit(const BisectOptions &options, const QString &sessionLabel, const QString &commit,
+                          qreal *value, QString *error)
+{
+    const QString worktree = options.worktree.isEmpty() ? options.repository + "-bisect" : options.worktree;
+    RunStatus status = gitCheckout(options.repository, worktree, commit);
+    if (status.ok() == false) {
+        *error = "checking out " + commit + " failed: " + QString::fromLocal8Bit(status.output);
+        return false;
+    }
+
+    const QString benchmarkDir = QDir(worktree).filePath(options.benchmarkPath);
+    status = buildTest(benchmarkDir, options.qmakePath, QString(), options.buildOptions);
+    if (status.ok() == false) {
+        *error = "building " + commit + " failed: " + QString::fromLocal8Bit(status.output);
+        return false;
+    }
+
+    QStringList arguments;
+    if (options.function.isEmpty() == false)
+        arguments += options.tag.isEmpty() ? options.function : options.function + ":" + options.tag;
+    const QString executable = QDir(benchmarkDir).filePath(options.executable);
+    const QString runLabel = sessionLabel + "/" + commit;
+    QString testCase = options.testCase;
+    for (int i = 0; i < options.repetitions; ++i) {
+        QString reportedTestCase;
+        status = runBenchmarkIntoDataBase(QString(), benchmarkDir, executable, options.runOptions, runLabel, -1, arguments,
+                                          &reportedTestCase);
+        if (testCase.isEmpty())
+            testCase = reportedTestCase;
+        if (status.ok() == false) {
+            *error = "running the benchmark at " + commit + " failed: " + QString::fromLocal8Bit(status.output);
+            return false;
+        }
+    }
+
+    const QList<qreal> values = storedValues(options, testCase, runLabel);
+    if (values.isEmpty()) {
+        *error = "no " + options.metric + " result for " + options.function + "(" + options.tag + ") at " + commit;
+        return false;
+    }
+    *value = median(values);
+    qDebug() << "measured" << commit << *value;
+    return true;
+}
+
+/*
+    Bisects options.range for the first commit at which the selected result regresses
+    compared to the good end of the range. The results database must be open. Both ends
+    are measured first; if the last commit is not regressed, there is nothing to find.
+*/
+BisectResult bisectRegression(const BisectOptions &options)
+{
+    BisectResult result;
+    result.runLabel = options.runLabel.isEmpty()
+        ? "bisect " + QDateTime::currentDateTime().toString(Qt::ISODate) : options.runLabel;
+    const QString goodCommit = options.range.section("..", 0, 0);
+    const QStringList commits = gitRevList(options.repository, options.range, true);
+    if (goodCommit.isEmpty() || commits.isEmpty()) {
+        result.error = "no commits in " + options.range;
+        return result;
+    }
+
+    qreal baseline;
+    if (measureCommit(options, result.runLabel, goodCommit, &baseline, &result.error) == false)
+        return result;
+    result.values.insert(goodCommit, baseline);
+
+    // Regressed commits are worse than the baseline by more than the threshold.
+    const qreal sign = higherIsBetter(options.metric) ? -1 : 1;
+    const qreal limit = options.threshold / 100;
+
+    // Invariant: commits.at(good) is not regressed (-1 is the good end), commits.at(bad) is.
+    int good = -1;
+    int bad = commits.count() - 1;
+    qreal value;
+    if (measureCommit(options, result.runLabel, commits.at(bad), &value, &result.error) == false)
+        return result;
+    result.values.insert(commits.at(bad), value);
+    if (baseline == 0 || sign * (value / baseline - 1) <= limit)
+        return result;
+
+    while (bad - good > 1) {
+        const int mid = (good + bad) / 2;
+        if (measureCommit(options, result.runLabel, commits.at(mid), &value, &result.error) == false)
+            return result;
+        result.values.insert(commits.at(mid), value);
+        if (sign * (value / baseline - 1) > limit)
+            bad = mid;
+        else
+            good = mid;
+    }
+
+    result.firstBadCommit = commits.at(bad);
+    return result;
+}
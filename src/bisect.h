@@ -0,0 +1,88 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef BISECT_H
+#define BISECT_H
+
+#include <QtCore>
+#include "buildrun.h"
+
+/*
+    Options for finding the commit that made a benchmark slower. range is a git commit
+    range like "good..bad", whose first commit must not have the regression and whose
+    last commit must. benchmarkPath is the directory of the benchmark within the
+    repository and executable the test binary built there; function, tag and metric
+    select the result to watch. A commit counts as regressed when the result is worse
+    than at the good commit by more than threshold percent. Each commit is built in
+    worktree (by default next to the repository) with buildOptions, and the benchmark
+    is run repetitions times, the median being used.
+
+    Each tried commit is stored in the results database under the run label
+    "<runLabel>/<commit>", runLabel naming the bisect session (the start time by default),
+    so that sessions do not mix. Results are taken from the test case testCase, by default
+    the one the benchmark executable reports.
+
+    Only the first-parent history of the range is bisected: a merge counts as one commit,
+    and the commits of merged branches, whose order by date says nothing about which
+    introduced the change, are not tried. A regression found at a merge is then narrowed
+    down by bisecting the merged branch separately.
+*/
+class BisectOptions
+{
+public:
+    BisectOptions()
+    : threshold(5), repetitions(5)
+    {
+        buildOptions.incremental = true;
+    }
+    QString repository;
+    QString range;
+    QString worktree;
+    QString benchmarkPath;
+    QString executable;
+    QString qmakePath;
+    QString runLabel;
+    QString testCase;
+    QString function;
+    QString tag;
+    QString metric;
+    qreal threshold;
+    int repetitions;
+    BuildOptions buildOptions;
+    RunOptions runOptions;
+};
+
+// The first regressed commit, if any, and the value measured at each commit that was
+// tried. runLabel is the label of the session the tried commits are stored under.
+class BisectResult
+{
+public:
+    QString runLabel;
+    QString firstBadCommit;
+    QString error;
+    QMap<QString, qreal> values;
+    bool found() const { return !firstBadCommit.isEmpty(); }
+};
+
+BisectResult bisectRegression(const BisectOptions &options);
+
+#endif
@@ -21,7 +21,22 @@
 **
 ****************************************************************************/
 #include "buildrun.h"
-#include "benchmark.h"
+#include "database.h"
+#include "perfcounters.h"
+#include <stdio.h>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#endif
 
 
 int runExecutable(const QString &workdir, const QString &executable, const QStringList &arguments = QStringList())
@@ -62,13 +77,18 @@ RunStatus runExecutableEx(const QString &workdir, const QString &executable, con
         p.start(executable, arguments);
 
     if (p.waitForFinished(-1) == false) {
-        status.error = RunStatus::NotFoundError;
-        status.output = "Running " + executable.toAscii() + " failed with error string: " + p.errorString().toAscii();
+        status.error = p.error() == QProcess::FailedToStart ? RunStatus::NotFoundError : RunStatus::CrashError;
+        status.output = "Running " + executable.toLocal8Bit() + " failed with error string: " + p.errorString().toLocal8Bit();
 //        QDir::setCurrent(previousWoringDirectory.path());
         return status;
     }
     status.output = p.readAll();
+    if (p.exitStatus() == QProcess::CrashExit) {
+        status.error = RunStatus::CrashError;
+        return status;
+    }
     int code = p.exitCode();
+    status.exitCode = code;
     if (code != 0) {
 //        qDebug() << "fail",    
         status.error = RunStatus::RuntimeError;
@@ -93,7 +113,7 @@ QByteArray pipeExecutable(const QString &workdir, const QString &executable, con
     return p.readAll();
 }
 
-// returns false on timeout
+// returns false on timeout or if the executable could not be started
 bool forwardExecutable(const QString &workdir, const QString &executable, int timeout, const QStringList &arguments, const QString &pathAddition)
 {
     QProcess p;
@@ -109,9 +129,9 @@ bool forwardExecutable(const QString &workdir, const QString &executable, int ti
         p.setWorkingDirectory(workdir);
     p.start(executable, arguments);
 
-    if (p.waitForStarted(500) == false) {
+    if (p.waitForStarted(-1) == false) {
         qDebug() << QString("run " + executable + " failed to start");
-        return true;
+        return false;
     }
 
     if (p.waitForFinished(timeout) == false) {
@@ -133,6 +153,484 @@ bool runBenchmark(const QString &qtDir, const QString &workdir, const QString &e
     return forwardExecutable(workdir, executable, timeout, arguments, qtDirCopy);
 }
 
+// CPU affinity and scheduling
+
+// Parses lists like "2,3" or "0-3,8" as used by taskset and /sys.
+QList<int> parseCpuList(const QString &cpuList)
+{
+    QList<int> cpus;
+    foreach (QString range, cpuList.split(",", QString::SkipEmptyParts)) {
+        const QStringList bounds = range.trimmed().split("-");
+        bool ok1 = false;
+        bool ok2 = false;
+        const int first = bounds.first().toInt(&ok1);
+        const int last = bounds.last().toInt(&ok2);
+        if (!ok1 || !ok2 || bounds.count() > 2)
+            return QList<int>();
+        for (int cpu = first; cpu <= last; ++cpu) {
+            if (!cpus.contains(cpu))
+                cpus += cpu;
+        }
+    }
+    qSort(cpus);
+    return cpus;
+}
+
+QString cpuListString(const QList<int> &cpus)
+{
+    QStringList ranges;
+    for (int i = 0; i < cpus.count(); ++i) {
+        int last = i;
+        while (last + 1 < cpus.count() && cpus.at(last + 1) == cpus.at(last) + 1)
+            ++last;
+        if (last == i)
+            ranges += QString::number(cpus.at(i));
+        else
+            ranges += QString::number(cpus.at(i)) + "-" + QString::number(cpus.at(last));
+        i = last;
+    }
+    return ranges.join(",");
+}
+
+#ifdef Q_OS_LINUX
+static QList<int> cpusOf(const cpu_set_t &set)
+{
+    QList<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set))
+            cpus += cpu;
+    }
+    return cpus;
+}
+#endif
+
+// Applies the RunOptions in the child between fork and exec.
+//
+// QProcess reaps its children itself, so their resource usage can not be had from
+// wait4() in the runner. To measure it, the child forks once more: the new process
+// goes on to exec the benchmark, while the child stays behind as a reaper that waits
+// for it with wait4(), writes the usage to a temporary file and exits the way the
+// benchmark did. The reaper also opens the performance counters on the benchmark
+// before letting it exec, and reads them when it has exited.
+//
+// The usage file starts with the process id of the benchmark, which the reaper writes
+// before the benchmark execs, so it is there once the process has started.
+class BenchmarkProcess : public QProcess
+{
+public:
+    BenchmarkProcess(const RunOptions &options);
+    qint64 benchmarkId();
+    ProcessUsage usage();
+protected:
+    void setupChildProcess();
+private:
+    void reapBenchmark();
+
+    RunOptions m_options;
+    QTemporaryFile m_usageFile;
+    int m_usageFd;
+};
+
+BenchmarkProcess::BenchmarkProcess(const RunOptions &options)
+: m_options(options), m_usageFd(-1)
+{
+#ifdef Q_OS_LINUX
+    if (m_options.measureUsage && m_usageFile.open())
+        m_usageFd = m_usageFile.handle();
+#endif
+}
+
+#ifdef Q_OS_LINUX
+// What the reaper writes to the usage file, after the process id of the benchmark.
+struct UsageReport
+{
+    struct rusage usage;
+    quint64 counterMask;
+    quint64 counters[PerfCounterCount];
+};
+#endif
+
+// The process id of the benchmark itself, which is not the started process when the
+// reaper runs in between.
+qint64 BenchmarkProcess::benchmarkId()
+{
+#ifdef Q_OS_LINUX
+    if (m_usageFd >= 0) {
+        m_usageFile.seek(0);
+        const QByteArray data = m_usageFile.read(sizeof(qint64));
+        qint64 pid = 0;
+        if (data.size() == int(sizeof(pid)))
+            memcpy(&pid, data.constData(), sizeof(pid));
+        if (pid > 0)
+            return pid;
+    }
+#endif
+    return processId();
+}
+
+ProcessUsage BenchmarkProcess::usage()
+{
+    ProcessUsage processUsage;
+#ifdef Q_OS_LINUX
+    if (m_usageFd < 0)
+        return processUsage;
+    m_usageFile.seek(0);
+    const QByteArray data = m_usageFile.readAll();
+    UsageReport report;
+    if (data.size() != int(sizeof(qint64) + sizeof(report))) {
+        if (data.size() > int(sizeof(qint64)))
+            qDebug() << "ignoring an incomplete usage report of" << data.size() << "bytes";
+        return processUsage;
+    }
+    memcpy(&report, data.constData() + sizeof(qint64), sizeof(report));
+    const struct rusage &usage = report.usage;
+
+    processUsage.valid = true;
+    processUsage.maxResidentKilobytes = usage.ru_maxrss;
+    processUsage.minorFaults = usage.ru_minflt;
+    processUsage.majorFaults = usage.ru_majflt;
+    processUsage.voluntaryContextSwitches = usage.ru_nvcsw;
+    processUsage.involuntaryContextSwitches = usage.ru_nivcsw;
+    processUsage.userTime = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+    processUsage.systemTime = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+
+    for (int counter = 0; counter < PerfCounterCount; ++counter) {
+        if ((report.counterMask & (Q_UINT64_C(1) << counter)) == 0)
+            continue;
+        qreal value = report.counters[counter];
+        if (counter == TaskClockCounter)
+            value /= 1000000; // nanoseconds
+        processUsage.counters.insert(perfCounterMetric(counter), value);
+    }
+#endif
+    return processUsage;
+}
+
+#ifdef Q_OS_LINUX
+// Closes the descriptors from 3 up in the forked reaper, except \a keep1 and \a keep2.
+// Runs between fork and exit, so this sticks to plain system calls and no allocation.
+static void closeInheritedFds(int keep1, int keep2)
+{
+#ifdef SYS_close_range
+    const int kept[2] = { qMin(keep1, keep2), qMax(keep1, keep2) };
+    unsigned int first = 3;
+    bool closed = true;
+    for (int i = 0; i < 2 && closed; ++i) {
+        if (kept[i] < int(first))
+            continue;
+        if (kept[i] > int(first))
+            closed = syscall(SYS_close_range, first, kept[i] - 1, 0) == 0;
+        first = kept[i] + 1;
+    }
+    if (closed && syscall(SYS_close_range, first, ~0U, 0) == 0)
+        return;
+#endif
+    // Without close_range (before Linux 5.9), walk /proc/self/fd.
+    const int dir = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir == -1) {
+        const long maxFd = sysconf(_SC_OPEN_MAX);
+        for (long fd = 3; fd < maxFd; ++fd) {
+            if (fd != keep1 && fd != keep2)
+                close(fd);
+        }
+        return;
+    }
+    char buffer[4096];
+    long size;
+    while ((size = syscall(SYS_getdents64, dir, buffer, sizeof(buffer))) > 0) {
+        for (long offset = 0; offset < size; ) {
+            // struct linux_dirent64: ino, off, reclen, type, name
+            const char *entry = buffer + offset;
+            unsigned short length;
+            memcpy(&length, entry + 16, sizeof(length));
+            const char *name = entry + 19;
+            int fd = 0;
+            for (; *name >= '0' && *name <= '9'; ++name)
+                fd = fd * 10 + (*name - '0');
+            if (*name == 0 && name != entry + 19 && fd >= 3 && fd != dir && fd != keep1 && fd != keep2)
+                close(fd);
+            offset += length;
+        }
+    }
+    close(dir);
+}
+#endif
+
+// Runs in the forked child and returns only in the process that is to exec the
+// benchmark.
+void BenchmarkProcess::reapBenchmark()
+{
+#ifdef Q_OS_LINUX
+    // The benchmark waits for the reaper to open the counters before it execs.
+    int counterPipe[2];
+    if (pipe(counterPipe) == -1)
+        return;
+
+    const pid_t reaper = getpid();
+    const pid_t benchmark = fork();
+    if (benchmark < 0)
+        return; // no usage then, but the benchmark still runs
+    if (benchmark == 0) {
+        // The benchmark must not outlive the reaper when the runner kills it on a timeout.
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != reaper)
+            _exit(127);
+        close(counterPipe[1]);
+        char ready;
+        while (read(counterPipe[0], &ready, 1) == -1 && errno == EINTR) { }
+        close(counterPipe[0]);
+        return;
+    }
+
+    // QProcess tells a successful exec from the closing of a pipe that the reaper would
+    // hold open, so it keeps nothing but the usage file.
+    closeInheritedFds(m_usageFd, counterPipe[1]);
+
+    // Without it the parent falls back to the process id of the reaper.
+    const qint64 benchmarkId = benchmark;
+    const ssize_t idWritten = pwrite(m_usageFd, &benchmarkId, sizeof(benchmarkId), 0);
+    Q_UNUSED(idWritten);
+
+    UsageReport report;
+    memset(&report, 0, sizeof(report));
+    int counterFds[PerfCounterCount];
+    for (int counter = 0; counter < PerfCounterCount; ++counter)
+        counterFds[counter] = -1;
+    if (m_options.perfCounters)
+        openPerfCounters(benchmark, counterFds);
+    while (write(counterPipe[1], "", 1) == -1 && errno == EINTR) { }
+    close(counterPipe[1]);
+
+    int status = 0;
+    while (wait4(benchmark, &status, 0, &report.usage) == -1) {
+        if (errno != EINTR)
+            _exit(127);
+    }
+    report.counterMask = readPerfCounters(counterFds, report.counters);
+    // A failed or short write leaves the file short of a full report, which the parent
+    // takes as no usage.
+    const ssize_t reportWritten = pwrite(m_usageFd, &report, sizeof(report), sizeof(benchmarkId));
+    Q_UNUSED(reportWritten);
+
+    if (WIFSIGNALED(status)) {
+        signal(WTERMSIG(status), SIG_DFL);
+        raise(WTERMSIG(status));
+    }
+    _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 127);
+#endif
+}
+
+// Runs in the forked child, so this sticks to plain system calls. Failures (typically
+// missing privileges for SCHED_FIFO or negative nice values) are ignored here and show
+// up in the properties read back by the parent.
+void BenchmarkProcess::setupChildProcess()
+{
+#ifdef Q_OS_LINUX
+    if (m_options.cpus.isEmpty() == false) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int i = 0; i < m_options.cpus.count(); ++i)
+            CPU_SET(m_options.cpus.at(i), &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+    if (m_options.fifoPriority > 0) {
+        sched_param param;
+        param.sched_priority = m_options.fifoPriority;
+        sched_setscheduler(0, SCHED_FIFO, &param);
+    }
+    if (m_options.niceLevel != 0)
+        setpriority(PRIO_PROCESS, 0, m_options.niceLevel);
+    if (m_usageFd >= 0)
+        reapBenchmark();
+#endif
+}
+
+// Reads back the affinity and scheduling of the running process \a pid. If the process
+// has exited already, the requested values are reported instead.
+static QHash<QString, QString> schedulingProperties(qint64 pid, const RunOptions &options)
+{
+    QHash<QString, QString> properties;
+    properties.insert("CpuAffinity", cpuListString(options.cpus));
+    properties.insert("Scheduler", options.fifoPriority > 0 ? QString("SCHED_FIFO %1").arg(options.fifoPriority) : QString("SCHED_OTHER"));
+    properties.insert("Nice", QString::number(options.niceLevel));
+#ifdef Q_OS_LINUX
+    cpu_set_t set;
+    if (sched_getaffinity(pid, sizeof(set), &set) == 0)
+        properties.insert("CpuAffinity", cpuListString(cpusOf(set)));
+    sched_param param;
+    const int policy = sched_getscheduler(pid);
+    if (policy != -1 && sched_getparam(pid, &param) == 0)
+        properties.insert("Scheduler", policy == SCHED_FIFO ? QString("SCHED_FIFO %1").arg(param.sched_priority) : QString("SCHED_OTHER"));
+    errno = 0;
+    const int niceLevel = getpriority(PRIO_PROCESS, pid);
+    if (errno == 0)
+        properties.insert("Nice", QString::number(niceLevel));
+#else
+    Q_UNUSED(pid);
+#endif
+    return properties;
+}
+
+// Moves the calling thread off \a cpus for the lifetime of the object, so the runner
+// does not compete with the benchmark for the measured cores.
+class RunnerIsolation
+{
+public:
+    RunnerIsolation(const RunOptions &options)
+    : m_isolated(false)
+    {
+#ifdef Q_OS_LINUX
+        if (options.isolateRunner == false || options.cpus.isEmpty())
+            return;
+        if (sched_getaffinity(0, sizeof(m_previous), &m_previous) != 0)
+            return;
+        cpu_set_t set = m_previous;
+        for (int i = 0; i < options.cpus.count(); ++i)
+            CPU_CLR(options.cpus.at(i), &set);
+        if (CPU_COUNT(&set) == 0) {
+            qDebug() << "not isolating the runner: no cores left besides" << cpuListString(options.cpus);
+            return;
+        }
+        m_isolated = sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        Q_UNUSED(options);
+#endif
+    }
+
+    ~RunnerIsolation()
+    {
+#ifdef Q_OS_LINUX
+        if (m_isolated)
+            sched_setaffinity(0, sizeof(m_previous), &m_previous);
+#endif
+    }
+
+private:
+    bool m_isolated;
+#ifdef Q_OS_LINUX
+    cpu_set_t m_previous;
+#endif
+};
+
+static void forwardStandardError(QProcess &p)
+{
+    const QByteArray error = p.readAllStandardError();
+    if (error.isEmpty() == false)
+        fwrite(error.constData(), 1, error.size(), stderr);
+}
+
+// Runs a benchmark with \a options. With a \a loader, the standard output of the
+// benchmark is passed to it while the benchmark runs, otherwise it is forwarded.
+static RunStatus runBenchmark(const QString &qtDir, const QString &workdir, const QString &executable, const RunOptions &options,
+                              int timeout, const QStringList &arguments, XmlResultLoader *loader)
+{
+    RunStatus status;
+    status.properties = environmentFingerprint();
+    if (preflightCheck(status.properties, options.preflight) == false) {
+        status.error = RunStatus::EnvironmentError;
+        status.output = "Not running " + executable.toLocal8Bit() + ": " + configurationWarnings(status.properties).join(", ").toLocal8Bit();
+        return status;
+    }
+
+    RunnerIsolation isolation(options);
+
+    BenchmarkProcess p(options);
+    p.setProcessChannelMode(loader ? QProcess::SeparateChannels : QProcess::ForwardedChannels);
+    if (qtDir.isEmpty() == false) {
+        QStringList env = QProcess::systemEnvironment();
+        env.replaceInStrings(QRegExp("^PATH=(.*)", Qt::CaseInsensitive), "PATH=" + qtDir + "/bin" + QDir::listSeparator() + "\\1");
+        p.setEnvironment(env);
+    }
+    if (workdir != QString())
+        p.setWorkingDirectory(workdir);
+    p.start(executable, arguments);
+
+    if (p.waitForStarted(-1) == false) {
+        status.error = RunStatus::NotFoundError;
+        status.output = "Running " + executable.toLocal8Bit() + " failed with error string: " + p.errorString().toLocal8Bit();
+        return status;
+    }
+    status.properties.unite(schedulingProperties(p.benchmarkId(), options));
+
+    QElapsedTimer timer;
+    timer.start();
+    while (p.state() != QProcess::NotRunning) {
+        if (timeout >= 0 && timer.elapsed() >= timeout) {
+            p.kill();
+            p.waitForFinished(-1);
+            status.error = RunStatus::TimeoutError;
+            status.output = "Running " + executable.toLocal8Bit() + " timed out";
+            return status;
+        }
+        const int wait = timeout < 0 ? 1000 : int(qMin(qint64(1000), timeout - timer.elapsed()));
+        if (loader) {
+            p.waitForReadyRead(wait);
+            loader->addData(p.readAllStandardOutput());
+            forwardStandardError(p);
+        } else {
+            p.waitForFinished(wait);
+        }
+    }
+    if (loader) {
+        loader->addData(p.readAllStandardOutput());
+        forwardStandardError(p);
+        loader->finish();
+        status.output = "Loaded " + QByteArray::number(loader->resultCount()) + " results\n";
+    }
+    status.usage = p.usage();
+    if (p.exitStatus() == QProcess::CrashExit) {
+        status.error = RunStatus::CrashError;
+        status.output = "Running " + executable.toLocal8Bit() + " crashed";
+        return status;
+    }
+    status.exitCode = p.exitCode();
+    if (status.exitCode != 0)
+        status.error = RunStatus::RuntimeError;
+    return status;
+}
+
+// Like runBenchmark() above, but applies \a options to the benchmark process and
+// returns the environment fingerprint and the scheduling it ran with in
+// RunStatus::properties.
+RunStatus runBenchmark(const QString &qtDir, const QString &workdir, const QString &executable, const RunOptions &options, int timeout, const QStringList &arguments)
+{
+    return runBenchmark(qtDir, workdir, executable, options, timeout, arguments, 0);
+}
+
+// Runs a benchmark with -xml and loads its results into the open results database
+// under \a runLabel as they are printed, without going through a file. The run
+// properties are stored for \a runLabel as well, and the resource usage of the
+// process is loaded as the results of a "processUsage" test function. The name of
+// the test case that ran is returned in \a testCase, if given.
+//
+// The results go into the database in one transaction, which is rolled back when the
+// benchmark fails, crashes or times out, so no partial run is left behind. Inside a
+// transaction that is already open, that is up to the caller.
+RunStatus runBenchmarkIntoDataBase(const QString &qtDir, const QString &workdir, const QString &executable, const RunOptions &options,
+                                   const QString &runLabel, int timeout, const QStringList &arguments,
+                                   QString *testCase)
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    const bool transaction = db.transaction();
+
+    XmlResultLoader loader(QFileInfo(executable).fileName(), runLabel);
+    RunStatus status = runBenchmark(qtDir, workdir, executable, options, timeout, QStringList() << arguments << "-xml", &loader);
+    if (status.properties.isEmpty() == false)
+        addRunProperties(runLabel, status.properties);
+    if (status.usage.valid)
+        loadXml(status.usage.toXml(loader.testCase()), "processUsage", runLabel);
+    if (testCase)
+        *testCase = loader.testCase();
+
+    if (transaction) {
+        if (status.ok())
+            db.commit();
+        else
+            db.rollback();
+    }
+    return status;
+}
+
 QHash<QString, QString> systemEnvitonment()
 {
     QHash<QString, QString> keyValues;
@@ -144,13 +642,14 @@ QHash<QString, QString> systemEnvitonment()
 }
 
 
-RunStatus qmake(const QString &path, const QString &qmakeBinaryPath, const QString &target)
+RunStatus qmake(const QString &path, const QString &qmakeBinaryPath, const QString &target, const QStringList &extraArguments)
 {
     QStringList arguments;
     if (target != QString()) {
         arguments += "-after";
         arguments += "TARGET=" + target;
     }
+    arguments += extraArguments;
 
     return runExecutableEx(path, qmakeBinaryPath, arguments);
 }
@@ -161,8 +660,12 @@ RunStatus runMake(const QString &path, const QString &argument)
     QStringList arguments;
     if (argument != QString())
         arguments.append(argument);
+    return runMake(path, arguments);
+}
 
-#ifdef Q_WS_WIN
+RunStatus runMake(const QString &path, const QStringList &arguments)
+{
+#ifdef Q_OS_WIN
     // ### do this the right way :)
 
     QStringList possibleMakePaths = QStringList() 
@@ -172,7 +675,7 @@ RunStatus runMake(const QString &path, const QString &argument)
     
     foreach (QString nmake, possibleMakePaths) {
         if (QFile::exists(nmake))
-            return runExecutableEx(path, nmake, QStringList() << argument);
+            return runExecutableEx(path, nmake, arguments);
     }
     RunStatus status;
     status.error = RunStatus::NotFoundError;
@@ -183,17 +686,267 @@ RunStatus runMake(const QString &path, const QString &argument)
 #endif
 }
 
-RunStatus buildTest(const QString &path, const QString &qmakePath, const QString &target)
+// Build fingerprints
+
+static const char *fingerprintFileName = ".buildfingerprint";
+
+static bool isSourceFile(const QFileInfo &info)
+{
+    static const QStringList sourceSuffixes = QStringList()
+        << "c" << "cc" << "cpp" << "cxx" << "h" << "hpp" << "pro" << "pri" << "qrc" << "ui";
+    const QString name = info.fileName();
+    if (name.startsWith("moc_") || name.startsWith("qrc_") || name.startsWith("ui_"))
+        return false;
+    return sourceSuffixes.contains(info.suffix());
+}
+
+// Hashes the names, sizes and modification times of the libraries of the Qt that
+// \a qmakePath belongs to, so that rebuilding Qt invalidates the benchmark builds.
+// The result is cached per qmake binary.
+static QByteArray qtFingerprint(const QString &qmakePath)
+{
+    static QMutex mutex;
+    static QHash<QString, QByteArray> fingerprints;
+    QMutexLocker lock(&mutex);
+    if (fingerprints.contains(qmakePath))
+        return fingerprints.value(qmakePath);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const QFileInfo qmakeInfo(qmakePath);
+    hash.addData(qmakeInfo.absoluteFilePath().toUtf8());
+    hash.addData(qmakeInfo.lastModified().toString(Qt::ISODate).toUtf8());
+
+    const QString libraryPath = pipeExecutable(QString(), qmakePath, QStringList() << "-query" << "QT_INSTALL_LIBS").trimmed();
+    QDir libraryDir(libraryPath);
+    libraryDir.setFilter(QDir::Files);
+    libraryDir.setSorting(QDir::Name);
+    foreach (QFileInfo library, libraryDir.entryInfoList()) {
+        hash.addData(library.fileName().toUtf8());
+        hash.addData(QByteArray::number(library.size()));
+        hash.addData(library.lastModified().toString(Qt::ISODate).toUtf8());
+    }
+
+    const QByteArray fingerprint = hash.result().toHex();
+    fingerprints.insert(qmakePath, fingerprint);
+    return fingerprint;
+}
+
+static QString qtInstallPrefix(const QString &qmakePath)
+{
+    static QMutex mutex;
+    static QHash<QString, QString> prefixes;
+    QMutexLocker lock(&mutex);
+    if (prefixes.contains(qmakePath) == false) {
+        const QString prefix = pipeExecutable(QString(), qmakePath, QStringList() << "-query" << "QT_INSTALL_PREFIX").trimmed();
+        prefixes.insert(qmakePath, prefix.isEmpty() ? QString() : QDir(prefix).canonicalPath());
+    }
+    return prefixes.value(qmakePath);
+}
+
+// Returns the files the Makefiles qmake generated below \a path depend on: every source
+// file they name, wherever it is. That includes the .pro and .pri files, the sources from
+// other directories and the headers qmake found them to include. Files of the Qt
+// installation are covered by qtFingerprint() and left out.
+static QStringList makefileDependencies(const QString &path, const QString &qtPrefix)
+{
+    QSet<QString> dependencies;
+    QDirIterator it(path, QStringList() << "Makefile*", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFile makefile(it.next());
+        if (makefile.open(QIODevice::ReadOnly | QIODevice::Text) == false)
+            continue;
+        const QDir makefileDir = QFileInfo(makefile.fileName()).absoluteDir();
+        QString contents = QString::fromLocal8Bit(makefile.readAll());
+        contents.replace("\\\n", " ");
+        foreach (QString word, contents.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+            if (word.endsWith(':'))
+                word.chop(1);
+            const QFileInfo info(makefileDir, word);
+            if (isSourceFile(info) == false || info.isFile() == false)
+                continue;
+            const QString file = info.canonicalFilePath();
+            if (qtPrefix.isEmpty() == false && file.startsWith(qtPrefix + "/"))
+                continue;
+            dependencies.insert(file);
+        }
+    }
+    QStringList files = dependencies.values();
+    files.sort();
+    return files;
+}
+
+// Hashes the contents of the files the build in \a path depends on, as listed in its
+// Makefiles, together with everything else that goes into the build: the qmake
+// arguments and the Qt installation. qmake must have been run in \a path.
+static QByteArray buildFingerprint(const QString &path, const QString &qmakePath, const QStringList &qmakeArguments)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (QString dependency, makefileDependencies(path, qtInstallPrefix(qmakePath))) {
+        QFile file(dependency);
+        if (file.open(QIODevice::ReadOnly) == false)
+            continue;
+        hash.addData(dependency.toUtf8());
+        hash.addData(file.readAll());
+    }
+    hash.addData(qmakeArguments.join("\n").toUtf8());
+    hash.addData(qtFingerprint(qmakePath));
+    return hash.result().toHex();
+}
+
+static QByteArray readFingerprint(const QString &path)
+{
+    QFile file(QDir(path).filePath(fingerprintFileName));
+    if (file.open(QIODevice::ReadOnly) == false)
+        return QByteArray();
+    return file.readAll().trimmed();
+}
+
+static void writeFingerprint(const QString &path, const QByteArray &fingerprint)
+{
+    QFile file(QDir(path).filePath(fingerprintFileName));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false) {
+        qDebug() << "could not write" << file.fileName();
+        return;
+    }
+    file.write(fingerprint + "\n");
+}
+
+static RunStatus buildTest(const QString &path, const QString &qmakePath, const QString &target,
+                           const BuildOptions &options, const QStringList &makeArguments)
 {
 //    qDebug() << "building test in path" << path  << "with qmake" << qmakePath;
 
-    RunStatus status = qmake(path, qmakePath, target);
+    QStringList qmakeArguments;
+    if (options.compilerCache.isEmpty() == false) {
+        qmakeArguments += "-after";
+        qmakeArguments += "QMAKE_CC=" + options.compilerCache + " $$QMAKE_CC";
+        qmakeArguments += "QMAKE_CXX=" + options.compilerCache + " $$QMAKE_CXX";
+    }
+
+    RunStatus status = qmake(path, qmakePath, target, qmakeArguments);
    if (status.ok() == false)
         return status;
 
-    runMake(path, "clean");
+    // The Makefiles qmake just wrote tell what the build depends on.
+    QByteArray fingerprint;
+    if (options.incremental) {
+        fingerprint = buildFingerprint(path, qmakePath, QStringList() << target << qmakeArguments);
+        if (fingerprint == readFingerprint(path)) {
+            status.output += "Up to date, build skipped\n";
+            return status;
+        }
+        // A failed build must not leave the fingerprint of the previous one behind.
+        QFile::remove(QDir(path).filePath(fingerprintFileName));
+    } else {
+        runMake(path, "clean");
+    }
+
+    RunStatus makeStatus = runMake(path, makeArguments);
+    makeStatus.output.prepend(status.output);
+    if (options.incremental && makeStatus.ok())
+        writeFingerprint(path, fingerprint);
+    return makeStatus;
+}
+
+RunStatus buildTest(const QString &path, const QString &qmakePath, const QString &target)
+{
+    return buildTest(path, qmakePath, target, BuildOptions(), QStringList());
+}
+
+RunStatus buildTest(const QString &path, const QString &qmakePath, const QString &target, const BuildOptions &options)
+{
+    return buildTest(path, qmakePath, target, options, QStringList());
+}
+
+// Parallel builds
+
+class BuildState
+{
+public:
+    QMutex mutex;
+    QHash<QString, RunStatus> results;
+    QAtomicInt failed;
+};
+
+class BuildTask : public QRunnable
+{
+public:
+    BuildTask(const QString &path, const QString &qmakePath, const BuildOptions &options,
+              const QStringList &makeArguments, BuildState *state)
+    : m_path(path), m_qmakePath(qmakePath), m_options(options), m_makeArguments(makeArguments), m_state(state) { }
+    void run();
+private:
+    void writeLog(const RunStatus &status);
+
+    QString m_path;
+    QString m_qmakePath;
+    BuildOptions m_options;
+    QStringList m_makeArguments;
+    BuildState *m_state;
+};
+
+void BuildTask::run()
+{
+    RunStatus status;
+    if (m_options.failFast && m_state->failed.fetchAndAddOrdered(0)) {
+        status.error = RunStatus::CancelledError;
+        status.output = "Build skipped after an earlier build failed\n";
+    } else {
+        status = buildTest(m_path, m_qmakePath, QString(), m_options, m_makeArguments);
+        if (status.ok() == false)
+            m_state->failed.fetchAndStoreOrdered(1);
+        qDebug() << (status.ok() ? "built" : "FAILED to build") << m_path;
+    }
+    writeLog(status);
+
+    QMutexLocker lock(&m_state->mutex);
+    m_state->results.insert(m_path, status);
+}
 
-    return runMake(path);
+void BuildTask::writeLog(const RunStatus &status)
+{
+    if (m_options.logDirectory.isEmpty())
+        return;
+
+    QString logName = QDir::cleanPath(QDir(m_path).absolutePath());
+    logName.replace(QRegExp("[/\\\\:]"), "_");
+    QFile log(QDir(m_options.logDirectory).filePath(logName + ".log"));
+    if (log.open(QIODevice::WriteOnly | QIODevice::Truncate) == false) {
+        qDebug() << "could not write build log" << log.fileName();
+        return;
+    }
+    log.write(status.output);
+}
+
+/*
+    Builds the tests in \a paths using the qmake binary at \a qmakePath, running several
+    directories at once. The job budget is split between the directories being built
+    concurrently and the make processes within them: with fewer directories than jobs,
+    each make gets a share of the jobs as -j. Returns the status of each directory.
+*/
+QHash<QString, RunStatus> buildTests(const QStringList &paths, const QString &qmakePath, const BuildOptions &options)
+{
+    const int jobs = qMax(1, options.jobs);
+    const int concurrentBuilds = qMax(1, qMin(jobs, paths.count()));
+
+    QStringList makeArguments;
+#ifndef Q_OS_WIN
+    const int makeJobs = jobs / concurrentBuilds;
+    if (makeJobs > 1)
+        makeArguments += "-j" + QString::number(makeJobs);
+#endif
+
+    if (options.logDirectory.isEmpty() == false)
+        QDir().mkpath(options.logDirectory);
+
+    BuildState state;
+    QThreadPool pool;
+    pool.setMaxThreadCount(concurrentBuilds);
+    foreach (QString path, paths)
+        pool.start(new BuildTask(path, qmakePath, options, makeArguments, &state));
+    pool.waitForDone();
+
+    return state.results;
 }
 
 QByteArray runTest(const QString &path, const QString &executable, const QString &arg)
@@ -221,17 +974,34 @@ void p4sync(const QString &path)
     pipeExecutable(path, "p4", QStringList() << QString("sync") << QString("..."));
 }
 
-RunStatus buildBenchmark(const QString &benchmarkPath, const QString &qtPath)
+RunStatus git(const QString &repository, const QStringList &arguments)
 {
-    Benchmark b;
-    return b.buildBenchmark(qtPath, benchmarkPath, QString());
+    return runExecutableEx(repository, "git", arguments);
+}
+
+// Returns the commits in \a range (e.g. "v1.0..master"), oldest first. With
+// \a firstParent, merged branches are left out and only the commits along the first
+// parents are listed, the way the branch itself moved.
+QStringList gitRevList(const QString &repository, const QString &range, bool firstParent)
+{
+    QStringList arguments = QStringList() << "rev-list" << "--reverse";
+    if (firstParent)
+        arguments << "--first-parent";
+    RunStatus status = git(repository, arguments << range);
+    if (status.ok() == false) {
+        qDebug() << "git rev-list failed:" << status.output;
+        return QStringList();
+    }
+    return QString::fromLocal8Bit(status.output).split("\n", QString::SkipEmptyParts);
 }
 
-void runBenchmark(const QString &benchmarkPath, const QStringList &options)
+// Checks out \a commit in \a worktree, a separate working tree of \a repository that
+// is created on first use. Keeping the same worktree between checkouts lets
+// incremental builds reuse everything that did not change.
+RunStatus gitCheckout(const QString &repository, const QString &worktree, const QString &commit)
 {
-    QString partialName = QDir(benchmarkPath).dirName();
-    QString testExecutable = findExecutable(benchmarkPath, partialName);
-    QString testExecutablePath = benchmarkPath + "/" + testExecutable;
-    runBenchmark(QString(), benchmarkPath, testExecutablePath, -1 , options);
+    if (QDir(worktree).exists() == false)
+        return git(repository, QStringList() << "worktree" << "add" << "--detach" << worktree << commit);
+    return git(worktree, QStringList() << "checkout" << "--detach" << "--force" << commit);
 }
 
@@ -2,35 +2,102 @@
 #define BUILDRUN_H
 
 #include <QtCore>
+#include "environment.h"
+#include "processusage.h"
+
 class RunStatus
 {
 public:
     RunStatus()
     : exitCode(0), error(NoError) { }
-    enum Error { NoError, NotFoundError, RuntimeError };
+    // NotFoundError: the process could not be started. RuntimeError: it exited with a
+    // non-zero exit code. CrashError: it crashed. TimeoutError: it was killed after
+    // running for too long.
+    enum Error { NoError, NotFoundError, RuntimeError, CancelledError, EnvironmentError, CrashError, TimeoutError };
     int exitCode;
     Error error;
     QByteArray output;
-    bool ok() { return error == NoError; }
+    QHash<QString, QString> properties; // how and where the process was run, e.g. its CPU affinity
+    ProcessUsage usage; // resources used by the process, if measured
+    bool ok() const { return error == NoError; }
+};
+
+// Scheduling options for benchmark processes. cpus pins the process to the given cores;
+// fifoPriority > 0 runs it under SCHED_FIFO with that priority and niceLevel changes its
+// nice value. These need the right privileges and are silently left out otherwise;
+// RunStatus::properties records what was actually in effect. With isolateRunner, the
+// runner moves itself off the cores in cpus while the benchmark runs.
+// Only supported on Linux.
+//
+// Before the benchmark starts, the environment fingerprint is taken and checked according
+// to preflight; a refused run fails with EnvironmentError. The fingerprint is returned in
+// RunStatus::properties either way.
+//
+// With measureUsage, the resource usage of the benchmark process (see ProcessUsage) is
+// returned in RunStatus::usage, together with its performance counters if
+// perfCounters is set as well.
+class RunOptions
+{
+public:
+    RunOptions()
+    : fifoPriority(0), niceLevel(0), isolateRunner(false), preflight(WarnOnNoisyEnvironment), measureUsage(true), perfCounters(true) { }
+    QList<int> cpus;
+    int fifoPriority;
+    int niceLevel;
+    bool isolateRunner;
+    PreflightPolicy preflight;
+    bool measureUsage;
+    bool perfCounters;
+};
+
+QList<int> parseCpuList(const QString &cpuList);
+QString cpuListString(const QList<int> &cpus);
+
+// Options for building many tests at once. jobs is the total number of make jobs that
+// may run at the same time, spread over the directories being built. When logDirectory
+// is set, the qmake and make output of each directory is written to a log file there.
+// With failFast, directories that have not started building yet are skipped (with
+// CancelledError) as soon as one build fails.
+//
+// incremental skips the "make clean" before building, and skips make altogether when the
+// files the generated Makefiles depend on (sources, headers and project files, also those
+// outside the directory), the qmake arguments and the Qt installation are the same as at
+// the last successful build of the directory. compilerCache names a compiler wrapper such as ccache
+// that is put in front of the compilers.
+class BuildOptions
+{
+public:
+    BuildOptions()
+    : jobs(QThread::idealThreadCount()), failFast(true), incremental(false) { }
+    int jobs;
+    QString logDirectory;
+    bool failFast;
+    bool incremental;
+    QString compilerCache;
 };
 
 
-void runtests(const QString &basePath);
-void syncTest(const QString &path);
 RunStatus runMake(const QString &path, const QString &argument = QString());
+RunStatus runMake(const QString &path, const QStringList &arguments);
 RunStatus buildTest(const QString &path, const QString &qmakePath, const QString &target = QString());
+RunStatus buildTest(const QString &path, const QString &qmakePath, const QString &target, const BuildOptions &options);
+QHash<QString, RunStatus> buildTests(const QStringList &paths, const QString &qmakePath, const BuildOptions &options = BuildOptions());
 QByteArray runTest(const QString &path, const QString &executable, const QString &arg = QString());
 QByteArray runTest(const QString &path, const QString &executable, const QStringList &args);
-RunStatus qmake(const QString &path, const QString &qmakeBinaryPath, const QString &target = QString());
+RunStatus qmake(const QString &path, const QString &qmakeBinaryPath, const QString &target = QString(), const QStringList &extraArguments = QStringList());
 QHash<QString, QString> systemEnvitonment();
 
 bool forwardExecutable(const QString &workdir, const QString &executable, int timeout, const QStringList &arguments = QStringList(), const QString &pathAddition = QString());
 bool runBenchmark(const QString &qtPath, const QString &workdir, const QString &executable, int timeout = -1, const QStringList &arguments = QStringList());
+RunStatus runBenchmark(const QString &qtPath, const QString &workdir, const QString &executable, const RunOptions &options, int timeout = -1, const QStringList &arguments = QStringList());
+RunStatus runBenchmarkIntoDataBase(const QString &qtPath, const QString &workdir, const QString &executable, const RunOptions &options,
+                                   const QString &runLabel, int timeout = -1, const QStringList &arguments = QStringList(),
+                                   QString *testCase = 0);
 QByteArray pipeP4sync(const QString &path);
-bool p4sync(const QString &path, int change);
 void p4sync(const QString &path);
 
-RunStatus buildBenchmark(const QString &benchmarkPath, const QString &qtPath);
-void runBenchmark(const QString &benchmarkPath, const QStringList &options);
+RunStatus git(const QString &repository, const QStringList &arguments);
+QStringList gitRevList(const QString &repository, const QString &range, bool firstParent = false);
+RunStatus gitCheckout(const QString &repository, const QString &worktree, const QString &commit);
 
 #endif
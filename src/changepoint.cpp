@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "changepoint.h"
+#include "statistics.h"
+#include <math.h>
+
+// Change points are found with PELT (Killick, Fearnhead and Eckley, 2012),
+// using the cost of a change in mean under normally distributed noise. The
+// noise level is estimated from the differences between consecutive values,
+// which step changes hardly affect.
+
+static qreal noiseLevel(const QList<qreal> &series)
+{
+    QList<qreal> differences;
+    for (int i = 1; i < series.count(); ++i)
+        differences += series.at(i) - series.at(i - 1);
+
+    // MAD to standard deviation for normal data, and the differences of two
+    // independent values have sqrt(2) times the standard deviation.
+    const qreal sigma = medianAbsoluteDeviation(differences) * 1.4826 / sqrt(2.0);
+    if (sigma > 0)
+        return sigma;
+
+    // Deterministic metrics (e.g. callgrind) have no noise at all; any step is real.
+    const qreal scale = qAbs(median(series));
+    return scale > 0 ? scale * 1e-9 : 1e-9;
+}
+
+// Cost of the segment [s, t) given the cumulative sums of the values and their squares.
+static qreal segmentCost(const QVector<qreal> &sum, const QVector<qreal> &sumOfSquares,
+                         int s, int t, qreal variance)
+{
+    const qreal segmentSum = sum.at(t) - sum.at(s);
+    return (sumOfSquares.at(t) - sumOfSquares.at(s) - segmentSum * segmentSum / (t - s)) / variance;
+}
+
+QList<ChangePoint> detectChangePoints(const QList<qreal> &series, const ChangePointOptions &options)
+{
+    const int n = series.count();
+    const int minimumLength = qMax(1, options.minimumSegmentLength);
+    if (n < 2 * minimumLength)
+        return QList<ChangePoint>();
+
+    const qreal sigma = noiseLevel(series);
+    const qreal variance = sigma * sigma;
+    const qreal beta = options.penalty * log(qreal(n));
+
+    QVector<qreal> sum(n + 1, 0);
+    QVector<qreal> sumOfSquares(n + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        sum[i + 1] = sum.at(i) + series.at(i);
+        sumOfSquares[i + 1] = sumOfSquares.at(i) + series.at(i) * series.at(i);
+    }
+
+    QVector<qreal> best(n + 1, 0);
+    QVector<int> previous(n + 1, 0);
+    QList<int> candidates;
+    best[0] = -beta;
+
+    for (int t = minimumLength; t <= n; ++t) {
+        const int newCandidate = t - minimumLength;
+        if (newCandidate == 0 || newCandidate >= minimumLength)
+            candidates += newCandidate;
+
+        qreal bestCost = 0;
+        int bestStart = -1;
+        QVector<qreal> costs(candidates.count());
+        for (int i = 0; i < candidates.count(); ++i) {
+            const int s = candidates.at(i);
+            costs[i] = best.at(s) + segmentCost(sum, sumOfSquares, s, t, variance);
+            if (bestStart == -1 || costs.at(i) + beta < bestCost) {
+                bestCost = costs.at(i) + beta;
+                bestStart = s;
+            }
+        }
+        best[t] = bestCost;
+        previous[t] = bestStart;
+
+        // Pruning: a start that is already worse than the optimum by more than
+        // the penalty can never become optimal later.
+        QList<int> remaining;
+        for (int i = 0; i < candidates.count(); ++i) {
+            if (costs.at(i) <= bestCost)
+                remaining += candidates.at(i);
+        }
+        candidates = remaining;
+    }
+
+    QList<int> boundaries;
+    for (int t = n; t > 0; t = previous.at(t))
+        boundaries.prepend(t);
+    boundaries.prepend(0);
+
+    QList<ChangePoint> changePoints;
+    for (int i = 1; i + 1 < boundaries.count(); ++i) {
+        const QList<qreal> before = series.mid(boundaries.at(i - 1), boundaries.at(i) - boundaries.at(i - 1));
+        const QList<qreal> after = series.mid(boundaries.at(i), boundaries.at(i + 1) - boundaries.at(i));
+        ChangePoint changePoint;
+        changePoint.index = boundaries.at(i);
+        changePoint.before = median(before);
+        changePoint.after = median(after);
+        changePoint.confidence = 1 - welchTTest(before, after);
+        changePoints += changePoint;
+    }
+    return changePoints;
+}
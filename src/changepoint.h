@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef CHANGEPOINT_H
+#define CHANGEPOINT_H
+
+#include <QtCore>
+
+// A step change in a series of results. index is the position of the first
+// value after the change; before and after are the medians of the segments on
+// either side, and confidence is one minus the p-value of a t-test between them.
+struct ChangePoint
+{
+    ChangePoint() : index(-1), before(0), after(0), confidence(0) { }
+    int index;
+    qreal before;
+    qreal after;
+    qreal confidence;
+
+    qreal magnitude() const { return before == 0 ? 0 : after / before - 1; }
+};
+
+// penalty scales the cost of adding a change point (in units of log(n)),
+// minimumSegmentLength keeps single outliers from being reported as two steps.
+struct ChangePointOptions
+{
+    ChangePointOptions() : penalty(2), minimumSegmentLength(3) { }
+    qreal penalty;
+    int minimumSegmentLength;
+};
+
+QList<ChangePoint> detectChangePoints(const QList<qreal> &series,
+                                      const ChangePointOptions &options = ChangePointOptions());
+
+#endif
@@ -29,9 +29,20 @@
 
 QString resultsTable = QString("(TestName varchar, TestCaseName varchar, Series varchar, Idx varchar, ") + 
                        QString("Result varchar, ChartType varchar, Title varchar, ChartWidth varchar, ") + 
-                       QString("ChartHeight varchar, TestTitle varchar, QtVersion varchar, Iterations varchar") +
+                       QString("ChartHeight varchar, TestTitle varchar, QtVersion varchar, Iterations varchar, ") +
+                       QString("Metric varchar, RunLabel varchar") +
                        QString(")");
 
+// Properties of a run that are not part of any single result, such as the CPU affinity
+// the benchmarks ran with. One row per property.
+QString runsTable = QString("(RunLabel varchar, Name varchar, Value varchar)");
+
+// Result files that have been loaded, so that a directory can be ingested over and over
+// without loading a file twice. A file is identified by its path, size and modification time.
+// FirstRow and LastRow are the rowids of the Results rows it was loaded into.
+QString ingestedFilesTable = QString("(FileName varchar, Size varchar, Modified varchar, RunLabel varchar, "
+                                     "FirstRow integer, LastRow integer)");
+
 void execQuery(QSqlQuery query, bool warnOnFail)
 {
     bool ok = query.exec();
@@ -65,10 +76,130 @@ QSqlDatabase createDataBase(const QString &databaseFile)
 
     execQuery("DROP TABLE Results", false);
     execQuery("CREATE TABLE Results " + resultsTable);
+    execQuery("DROP TABLE Runs", false);
+    execQuery("CREATE TABLE Runs " + runsTable);
+    execQuery("DROP TABLE IngestedFiles", false);
+    execQuery("CREATE TABLE IngestedFiles " + ingestedFilesTable);
+
+    return db;
+}
+
+// Opens a persistent results database, creating the Results table if it
+// does not exist. Databases written before the Metric and RunLabel columns
+// were added are upgraded in place.
+QSqlDatabase openResultsDataBase(const QString &databaseFile)
+{
+    QSqlDatabase db = openDataBase(databaseFile);
+
+    execQuery("CREATE TABLE IF NOT EXISTS Results " + resultsTable);
+    execQuery("ALTER TABLE Results ADD COLUMN Metric varchar", false);
+    execQuery("ALTER TABLE Results ADD COLUMN RunLabel varchar", false);
+    execQuery("CREATE TABLE IF NOT EXISTS Runs " + runsTable);
+    execQuery("CREATE TABLE IF NOT EXISTS IngestedFiles " + ingestedFilesTable);
+    execQuery("ALTER TABLE IngestedFiles ADD COLUMN FirstRow integer", false);
+    execQuery("ALTER TABLE IngestedFiles ADD COLUMN LastRow integer", false);
 
     return db;
 }
 
+// Stores \a properties for the run \a runLabel, replacing earlier values of the same names.
+void addRunProperties(const QString &runLabel, const QHash<QString, QString> &properties)
+{
+    QHash<QString, QString>::const_iterator it;
+    for (it = properties.constBegin(); it != properties.constEnd(); ++it) {
+        QSqlQuery remove;
+        remove.prepare("DELETE FROM Runs WHERE RunLabel = :RunLabel AND Name = :Name");
+        remove.bindValue(":RunLabel", runLabel);
+        remove.bindValue(":Name", it.key());
+        execQuery(remove);
+
+        QSqlQuery insert;
+        insert.prepare("INSERT INTO Runs (RunLabel, Name, Value) VALUES (:RunLabel, :Name, :Value)");
+        insert.bindValue(":RunLabel", runLabel);
+        insert.bindValue(":Name", it.key());
+        insert.bindValue(":Value", it.value());
+        execQuery(insert);
+    }
+}
+
+QHash<QString, QString> runProperties(const QString &runLabel)
+{
+    QHash<QString, QString> properties;
+    QSqlQuery query;
+    query.prepare("SELECT Name, Value FROM Runs WHERE RunLabel = :RunLabel");
+    query.bindValue(":RunLabel", runLabel);
+    execQuery(query);
+    while (query.next())
+        properties.insert(query.value(0).toString(), query.value(1).toString());
+    return properties;
+}
+
+// Returns the highest rowid in Results, 0 if it is empty.
+qint64 lastResultRow()
+{
+    QSqlQuery query;
+    query.prepare("SELECT MAX(rowid) FROM Results");
+    execQuery(query);
+    return query.next() ? query.value(0).toLongLong() : 0;
+}
+
+bool isIngested(const QFileInfo &file)
+{
+    QSqlQuery query;
+    query.prepare("SELECT COUNT(*) FROM IngestedFiles WHERE FileName = :FileName AND Size = :Size AND Modified = :Modified");
+    query.bindValue(":FileName", file.absoluteFilePath());
+    query.bindValue(":Size", QString::number(file.size()));
+    query.bindValue(":Modified", file.lastModified().toString(Qt::ISODate));
+    execQuery(query);
+    return query.next() && query.value(0).toInt() > 0;
+}
+
+// Returns the Results rows an earlier version of \a file was loaded into in \a firstRow
+// and \a lastRow. Returns false if the file was not ingested, or before the rows were
+// recorded.
+bool ingestedRows(const QFileInfo &file, qint64 *firstRow, qint64 *lastRow)
+{
+    QSqlQuery query;
+    query.prepare("SELECT FirstRow, LastRow FROM IngestedFiles WHERE FileName = :FileName");
+    query.bindValue(":FileName", file.absoluteFilePath());
+    execQuery(query);
+    if (query.next() == false || query.value(0).isNull() || query.value(1).isNull())
+        return false;
+    *firstRow = query.value(0).toLongLong();
+    *lastRow = query.value(1).toLongLong();
+    return true;
+}
+
+// Records that \a file has been loaded under \a runLabel into the Results rows
+// \a firstRow to \a lastRow, replacing the record of an earlier version of it.
+void addIngestedFile(const QFileInfo &file, const QString &runLabel, qint64 firstRow, qint64 lastRow)
+{
+    QSqlQuery remove;
+    remove.prepare("DELETE FROM IngestedFiles WHERE FileName = :FileName");
+    remove.bindValue(":FileName", file.absoluteFilePath());
+    execQuery(remove);
+
+    QSqlQuery insert;
+    insert.prepare("INSERT INTO IngestedFiles (FileName, Size, Modified, RunLabel, FirstRow, LastRow) "
+                   "VALUES (:FileName, :Size, :Modified, :RunLabel, :FirstRow, :LastRow)");
+    insert.bindValue(":FileName", file.absoluteFilePath());
+    insert.bindValue(":Size", QString::number(file.size()));
+    insert.bindValue(":Modified", file.lastModified().toString(Qt::ISODate));
+    insert.bindValue(":RunLabel", runLabel);
+    insert.bindValue(":FirstRow", firstRow);
+    insert.bindValue(":LastRow", lastRow);
+    execQuery(insert);
+}
+
+void removeResultRows(qint64 firstRow, qint64 lastRow)
+{
+    QSqlQuery remove;
+    remove.prepare("DELETE FROM Results WHERE rowid >= :FirstRow AND rowid <= :LastRow");
+    remove.bindValue(":FirstRow", firstRow);
+    remove.bindValue(":LastRow", lastRow);
+    execQuery(remove);
+}
+
 struct Tag
 {
     Tag(QString key, QString value)
@@ -107,81 +238,127 @@ QList<Tag> parseTag(const QString &tag)
     return keyValues;
 }
 
-void loadXml(const QStringList &fileNames)
+// By convention, "--" separates series and indexes in tags. Results keep the two parts
+// in the Series and Idx columns; tagSeries() and tagIndex() split a tag (at the first
+// "--"), resultTag() puts it back together.
+QString tagSeries(const QString &tag)
+{
+    return tag.section("--", 0, 0);
+}
+
+QString tagIndex(const QString &tag)
+{
+    return tag.contains("--") ? tag.section("--", 1) : QString();
+}
+
+QString resultTag(const QString &series, const QString &index)
+{
+    return index.isEmpty() ? series : series + "--" + index;
+}
+
+void loadXml(const QStringList &fileNames, const QString &runLabel)
 {
     foreach(const QString &fileName, fileNames) {
         QFileInfo fi( fileName );
-        loadXml(fileName, fi.fileName());
+        loadXml(fileName, fi.fileName(), runLabel);
     }
 }
 
-void loadXml(const QString &fileName, const QString &context)
+void loadXml(const QString &fileName, const QString &context, const QString &runLabel)
 {
     QFile f(fileName);
     f.open(QIODevice::ReadOnly);
-    loadXml(f.readAll(), context);
+    loadXml(f.readAll(), context, runLabel);
+}
+
+void loadXml(const QByteArray &xml, const QString& context, const QString &runLabel)
+{
+    XmlResultLoader loader(context, runLabel);
+    loader.addData(xml);
+    loader.finish();
+}
+
+// XmlResultLoader implementation
+
+XmlResultLoader::XmlResultLoader(const QString &context, const QString &runLabel)
+: m_context(context), m_inQtVersion(false), m_resultCount(0)
+{
+    m_writer.runLabel = runLabel;
 }
 
-void loadXml(const QByteArray &xml, const QString& context)
+// Parses as much of \a data as possible and writes the results found to the database.
+// An element cut off at the end of \a data is completed by the next call.
+void XmlResultLoader::addData(const QByteArray &data)
 {
-    QDomDocument doc;
+    m_reader.addData(data);
+    readElements();
+}
 
-    int line;
-    int col;
-    QString errorMsg;
-    if (doc.setContent(xml, &errorMsg, &line, &col) == false) {
-        qDebug() << "dom setContent failed" << line << col << errorMsg;
+// Reports whether the document was complete and well-formed.
+bool XmlResultLoader::finish()
+{
+    if (m_reader.hasError()) {
+        qDebug() << "reading" << m_context << "failed" << m_reader.lineNumber() << m_reader.columnNumber() << m_reader.errorString();
+        return false;
     }
-    
-    // Grab "Value" from <Environment><QtVersion>Value</QtVersion></Environment>
-    QString qtVersion = doc.elementsByTagName("Environment").at(0).toElement().elementsByTagName("QtVersion")
-                        .at(0).toElement().childNodes().at(0).nodeValue();
-    QString testCase = doc.elementsByTagName("TestCase").at(0).toElement().attributeNode("name").value();
-        
-//    qDebug() << "qt version" << qtVersion;
-//    qDebug() << "test case" << testCase;
-
-    DataBaseWriter writer;
-    writer.testName = testCase; // testCaseName and testName is mixed up in the database writer class
-    writer.qtVersion = qtVersion;
-    
-    QDomNodeList testFunctions = doc.elementsByTagName("TestFunction");
-    for (int i = 0; i < testFunctions.count(); ++i) {
-        QDomElement function = testFunctions.at(i).toElement();
-        QString functionName = function.attributeNode("name").value();
-        writer.testCaseName = functionName; // testCaseName and testName is mixed up in the database writer class
-        
-//        qDebug() << "fn" << functionName;
-
-        QDomNodeList results = function.elementsByTagName("BenchmarkResult");
-        for (int j = 0; j < results.count(); ++j) {    
-            QDomElement result = results.at(j).toElement();
-            QString tag = result.attributeNode("tag").value();
-
-//            if (!context.isEmpty())
-//                tag += QString(" (%1)").arg(context);
-
-            QString series;
-            QString index;
-
-            // By convention, "--" separates series and indexes in tags.
-            if (tag.contains("--")) {
-                QStringList parts = tag.split("--");
-                series = parts.at(0);
-                index = parts.at(1);
-            } else {
-                series = tag;
-            }
+    return true;
+}
+
+int XmlResultLoader::resultCount() const
+{
+    return m_resultCount;
+}
 
-            QString resultString = result.attributeNode("value").value();
-            QString iterationCount = result.attributeNode("iterations").value();
-            double resultNumber = resultString.toDouble() / iterationCount.toDouble();
-            writer.addResult(series, index, QString::number(resultNumber), iterationCount);
-//            qDebug() << "result" << series  << index << tag << resultString << iterationCount;
+QString XmlResultLoader::testCase() const
+{
+    return m_writer.testName;
+}
+
+void XmlResultLoader::readElements()
+{
+    while (m_reader.atEnd() == false) {
+        m_reader.readNext();
+        if (m_reader.hasError())
+            return; // premature end of data, or an error reported by finish()
+
+        if (m_reader.isCharacters() && m_inQtVersion) {
+            // Grab "Value" from <Environment><QtVersion>Value</QtVersion></Environment>
+            m_writer.qtVersion += m_reader.text().toString();
+        } else if (m_reader.isEndElement()) {
+            if (m_reader.name() == "QtVersion")
+                m_inQtVersion = false;
+        } else if (m_reader.isStartElement()) {
+            const QXmlStreamAttributes attributes = m_reader.attributes();
+            if (m_reader.name() == "TestCase") {
+                m_writer.testName = attributes.value("name").toString(); // testCaseName and testName is mixed up in the database writer class
+            } else if (m_reader.name() == "QtVersion") {
+                m_writer.qtVersion.clear();
+                m_inQtVersion = true;
+            } else if (m_reader.name() == "TestFunction") {
+                m_writer.testCaseName = attributes.value("name").toString(); // testCaseName and testName is mixed up in the database writer class
+            } else if (m_reader.name() == "BenchmarkResult") {
+                addResult(attributes);
+            }
         }
     }
 }
 
+void XmlResultLoader::addResult(const QXmlStreamAttributes &attributes)
+{
+    QString tag = attributes.value("tag").toString();
+    m_writer.metric = attributes.value("metric").toString();
+
+    const QString series = tagSeries(tag);
+    const QString index = tagIndex(tag);
+
+    QString resultString = attributes.value("value").toString();
+    QString iterationCount = attributes.value("iterations").toString();
+    double resultNumber = resultString.toDouble() / iterationCount.toDouble();
+    // All 17 significant digits, so that instruction and event counts read back unchanged.
+    m_writer.addResult(series, index, QString::number(resultNumber, 'g', 17), iterationCount);
+    ++m_resultCount;
+}
+
 void displayTable(const QString &table)
 {
     QSqlTableModel *model = new QSqlTableModel();
@@ -213,16 +390,18 @@ void printDataBase()
 
 // TempTable implementation
 
+static void dropTable(QString *name)
+{
+    execQuery("DROP TABLE " + *name, false);
+    delete name;
+}
+
 static int tempTableIdentifier = 0;
 TempTable::TempTable(const QString &spec)
 {
     m_name = "TempTable" + QString::number(tempTableIdentifier++);
     execQuery("CREATE TEMP TABLE " + m_name + " " + spec);
-}
-
-TempTable::~TempTable()
-{
-    // ref count and drop it?
+    m_drop = QSharedPointer<QString>(new QString(m_name), dropTable);
 }
 
 QString TempTable::name()
@@ -237,6 +416,7 @@ DataBaseWriter::DataBaseWriter()
     disable = false;
     chartSize = QSize(800, 400);
     databaseFileName = ":memory:";
+    tableName = "Results";
     qtVersion = QT_VERSION_STR;
 }
 
@@ -280,8 +460,8 @@ void DataBaseWriter::addResult(const QString &series, const QString &index, cons
 
      QSqlQuery query;
 
-     query.prepare("INSERT INTO Results (TestName, TestCaseName, Series, Idx, Result, ChartWidth, ChartHeight, Title, TestTitle, ChartType, QtVersion, Iterations) "
-                    "VALUES (:TestName, :TestCaseName, :Series, :Idx, :Result, :ChartWidth, :ChartHeight, :Title, :TestTitle, :ChartType, :QtVersion, :Iterations)");
+     query.prepare("INSERT INTO " + tableName + " (TestName, TestCaseName, Series, Idx, Result, ChartWidth, ChartHeight, Title, TestTitle, ChartType, QtVersion, Iterations, Metric, RunLabel) "
+                    "VALUES (:TestName, :TestCaseName, :Series, :Idx, :Result, :ChartWidth, :ChartHeight, :Title, :TestTitle, :ChartType, :QtVersion, :Iterations, :Metric, :RunLabel)");
      query.bindValue(":TestName", testName);
      query.bindValue(":TestCaseName", testCaseName);
      query.bindValue(":Series", series);
@@ -293,6 +473,8 @@ void DataBaseWriter::addResult(const QString &series, const QString &index, cons
      query.bindValue(":TestTitle", testTitle);
      query.bindValue(":QtVersion", qtVersion);
      query.bindValue(":Iterations", iterations);
+     query.bindValue(":Metric", metric);
+     query.bindValue(":RunLabel", runLabel);
 
 
     if (chartType == LineChart)
@@ -27,12 +27,28 @@
 #include <QtSql>
 
 extern QString resultsTable;
+extern QString runsTable;
+extern QString ingestedFilesTable;
 QSqlDatabase openDataBase(const QString &databaseFile = "database");
 QSqlDatabase createDataBase(const QString &databaseFile = "database");
+QSqlDatabase openResultsDataBase(const QString &databaseFile = "database");
 
-void loadXml(const QStringList &fileNames);
-void loadXml(const QString &fileName, const QString &context=QString::null);
-void loadXml(const QByteArray &xml, const QString &context=QString::null);
+void addRunProperties(const QString &runLabel, const QHash<QString, QString> &properties);
+QHash<QString, QString> runProperties(const QString &runLabel);
+
+qint64 lastResultRow();
+bool isIngested(const QFileInfo &file);
+bool ingestedRows(const QFileInfo &file, qint64 *firstRow, qint64 *lastRow);
+void addIngestedFile(const QFileInfo &file, const QString &runLabel, qint64 firstRow, qint64 lastRow);
+void removeResultRows(qint64 firstRow, qint64 lastRow);
+
+QString tagSeries(const QString &tag);
+QString tagIndex(const QString &tag);
+QString resultTag(const QString &series, const QString &index);
+
+void loadXml(const QStringList &fileNames, const QString &runLabel=QString::null);
+void loadXml(const QString &fileName, const QString &context=QString::null, const QString &runLabel=QString::null);
+void loadXml(const QByteArray &xml, const QString &context=QString::null, const QString &runLabel=QString::null);
 
 void execQuery(QSqlQuery query, bool warnOnFail = true);
 void execQuery(const QString &spec, bool warnOnFail = true);
@@ -40,14 +56,15 @@ void displayDataBase(const QString &table = QString("Results"));
 void printDataBase();
 void displayTable(const QString &table);
 
+// A temporary table, dropped when the last copy of the TempTable is destroyed.
 class TempTable
 {
 public:
     TempTable(const QString &spec);
-    ~TempTable();
     QString name();
 private:
     QString m_name;
+    QSharedPointer<QString> m_drop;
 };
 
 enum ChartType { BarChart, LineChart };
@@ -63,6 +80,9 @@ public:
     QSize chartSize;
     QString chartTitle;
     QString qtVersion;
+    QString metric;
+    QString runLabel;
+    QString tableName;
     bool disable;
     
     void openDatabase();
@@ -79,4 +99,26 @@ public:
 };
 
 
+// Loads QTestLib XML into the results database while it is being produced, e.g. from
+// the output of a running benchmark. Results are written as soon as their element has
+// been read; loadXml() is a loader that is given the whole document at once.
+class XmlResultLoader
+{
+public:
+    XmlResultLoader(const QString &context = QString(), const QString &runLabel = QString());
+    void addData(const QByteArray &data);
+    bool finish();
+    int resultCount() const;
+    QString testCase() const;
+private:
+    void readElements();
+    void addResult(const QXmlStreamAttributes &attributes);
+
+    QXmlStreamReader m_reader;
+    DataBaseWriter m_writer;
+    QString m_context;
+    bool m_inQtVersion;
+    int m_resultCount;
+};
+
 #endif
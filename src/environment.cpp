@@ -0,0 +1,179 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "environment.h"
+
+// Everything is read from /proc and /sys, so only Linux gives a full fingerprint.
+
+static QString readFirstLine(const QString &fileName)
+{
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly) == false)
+        return QString();
+    return QString::fromLocal8Bit(file.readLine()).trimmed();
+}
+
+// Returns the values of the "key : value" lines with the given key, as found in
+// /proc/cpuinfo and /proc/meminfo.
+static QStringList procValues(const QString &fileName, const QString &key)
+{
+    QStringList values;
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly) == false)
+        return values;
+    QTextStream in(&file);
+    QString line = in.readLine();
+    while (line.isNull() == false) {
+        const int colon = line.indexOf(':');
+        if (colon != -1 && line.left(colon).trimmed() == key)
+            values += line.mid(colon + 1).trimmed();
+        line = in.readLine();
+    }
+    return values;
+}
+
+// /sys/kernel/mm/transparent_hugepage/enabled reads like "always [madvise] never".
+static QString selectedOption(const QString &options)
+{
+    QRegExp selected("\\[(\\w+)\\]");
+    if (selected.indexIn(options) == -1)
+        return options;
+    return selected.cap(1);
+}
+
+static int megabytes(const QString &meminfoValue)
+{
+    return meminfoValue.section(' ', 0, 0).toInt() / 1024;
+}
+
+EnvironmentFingerprint environmentFingerprint()
+{
+    EnvironmentFingerprint fingerprint;
+
+    const QStringList models = procValues("/proc/cpuinfo", "model name");
+    if (models.isEmpty() == false)
+        fingerprint.insert("CpuModel", models.first());
+    fingerprint.insert("CpuCount", QString::number(QThread::idealThreadCount()));
+
+    // Cores may use different governors; list each one once.
+    QStringList governors;
+    QDir cpuDir("/sys/devices/system/cpu");
+    foreach (QString cpu, cpuDir.entryList(QStringList() << "cpu[0-9]*", QDir::Dirs, QDir::Name)) {
+        const QString governor = readFirstLine(cpuDir.filePath(cpu + "/cpufreq/scaling_governor"));
+        if (governor.isEmpty() == false && governors.contains(governor) == false)
+            governors += governor;
+    }
+    if (governors.isEmpty() == false)
+        fingerprint.insert("ScalingGovernor", governors.join(","));
+
+    const QString frequency = readFirstLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq");
+    if (frequency.isEmpty() == false)
+        fingerprint.insert("CpuFrequency", QString::number(frequency.toInt() / 1000));
+
+    const QString noTurbo = readFirstLine("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    const QString boost = readFirstLine("/sys/devices/system/cpu/cpufreq/boost");
+    if (noTurbo.isEmpty() == false)
+        fingerprint.insert("Turbo", noTurbo == "1" ? "off" : "on");
+    else if (boost.isEmpty() == false)
+        fingerprint.insert("Turbo", boost == "1" ? "on" : "off");
+
+    const QString smt = readFirstLine("/sys/devices/system/cpu/smt/control");
+    if (smt.isEmpty() == false)
+        fingerprint.insert("Smt", smt);
+
+    const QString hugePages = readFirstLine("/sys/kernel/mm/transparent_hugepage/enabled");
+    if (hugePages.isEmpty() == false)
+        fingerprint.insert("TransparentHugePages", selectedOption(hugePages));
+
+    const QString loadAverage = readFirstLine("/proc/loadavg");
+    if (loadAverage.isEmpty() == false)
+        fingerprint.insert("LoadAverage", loadAverage.section(' ', 0, 0));
+
+    const QString kernelVersion = readFirstLine("/proc/sys/kernel/osrelease");
+    if (kernelVersion.isEmpty() == false)
+        fingerprint.insert("KernelVersion", kernelVersion);
+
+    const QStringList memTotal = procValues("/proc/meminfo", "MemTotal");
+    const QStringList memAvailable = procValues("/proc/meminfo", "MemAvailable");
+    if (memTotal.isEmpty() == false)
+        fingerprint.insert("MemTotal", QString::number(megabytes(memTotal.first())));
+    if (memAvailable.isEmpty() == false)
+        fingerprint.insert("MemAvailable", QString::number(megabytes(memAvailable.first())));
+
+    return fingerprint;
+}
+
+QStringList configurationWarnings(const EnvironmentFingerprint &fingerprint)
+{
+    QStringList warnings;
+
+    foreach (QString governor, fingerprint.value("ScalingGovernor").split(",", QString::SkipEmptyParts)) {
+        if (governor != "performance")
+            warnings += "CPU frequency governor is " + governor + ", not performance";
+    }
+    if (fingerprint.value("Turbo") == "on")
+        warnings += "turbo boost is enabled";
+    if (fingerprint.value("Smt") == "on")
+        warnings += "simultaneous multithreading is enabled";
+    if (fingerprint.value("TransparentHugePages") == "always")
+        warnings += "transparent hugepages are always enabled";
+
+    if (fingerprint.contains("MemTotal") && fingerprint.contains("MemAvailable")) {
+        const int memTotal = fingerprint.value("MemTotal").toInt();
+        const int memAvailable = fingerprint.value("MemAvailable").toInt();
+        if (memAvailable < memTotal / 10)
+            warnings += QString("only %1 MB of %2 MB memory available").arg(memAvailable).arg(memTotal);
+    }
+
+    return warnings;
+}
+
+QStringList environmentWarnings(const EnvironmentFingerprint &fingerprint)
+{
+    QStringList warnings = configurationWarnings(fingerprint);
+
+    // More than a core's worth of background load, or a tenth of the cores on big machines.
+    if (fingerprint.contains("LoadAverage")) {
+        const qreal loadAverage = fingerprint.value("LoadAverage").toDouble();
+        const qreal maximumLoad = qMax(qreal(1), fingerprint.value("CpuCount").toInt() / qreal(10));
+        if (loadAverage > maximumLoad)
+            warnings += QString("load average is %1").arg(loadAverage);
+    }
+
+    return warnings;
+}
+
+bool preflightCheck(const EnvironmentFingerprint &fingerprint, PreflightPolicy policy)
+{
+    if (policy == IgnoreNoisyEnvironment)
+        return true;
+
+    const QStringList warnings = environmentWarnings(fingerprint);
+    foreach (QString warning, warnings)
+        qDebug() << "WARNING: noisy environment:" << warning.toLocal8Bit().constData();
+
+    if (policy == RefuseNoisyEnvironment && configurationWarnings(fingerprint).isEmpty() == false) {
+        qDebug() << "refusing to run benchmarks in a noisy environment";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <QtCore>
+
+// The state of the machine that affects benchmark results, as name/value pairs:
+// CpuModel, CpuCount, ScalingGovernor, CpuFrequency (MHz), Turbo, Smt,
+// TransparentHugePages, LoadAverage, KernelVersion, MemTotal and MemAvailable (MB).
+// Values that can not be determined on this system are left out.
+typedef QHash<QString, QString> EnvironmentFingerprint;
+
+EnvironmentFingerprint environmentFingerprint();
+
+// Returns a description of each setting in \a fingerprint that is known to make
+// results noisy, e.g. a power saving frequency governor or a busy machine.
+QStringList environmentWarnings(const EnvironmentFingerprint &fingerprint);
+
+// Returns the warnings about how the machine is set up, leaving out its load. The load
+// average lags by minutes and includes the runner's own earlier runs, so it is only
+// ever a warning.
+QStringList configurationWarnings(const EnvironmentFingerprint &fingerprint);
+
+enum PreflightPolicy { IgnoreNoisyEnvironment, WarnOnNoisyEnvironment, RefuseNoisyEnvironment };
+
+// Prints the warnings for \a fingerprint unless the policy is to ignore them. Returns
+// false if the run should not go ahead, which a high load alone never causes.
+bool preflightCheck(const EnvironmentFingerprint &fingerprint, PreflightPolicy policy);
+
+#endif
@@ -0,0 +1,116 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "interleavedrun.h"
+#include "adaptiverun.h"
+#include "database.h"
+
+InterleavedRunResult runBenchmarksInterleaved(const InterleavedBenchmark &a, const InterleavedBenchmark &b,
+                                              const InterleavedRunOptions &options)
+{
+    InterleavedRunResult result;
+
+    // Only the functions both builds have can be compared.
+    QStringList functions;
+    if (options.perFunction) {
+        const QStringList functionsA = benchmarkFunctions(a.workdir, a.executable);
+        const QStringList functionsB = benchmarkFunctions(b.workdir, b.executable);
+        foreach (const QString &function, functionsA) {
+            if (functionsB.contains(function))
+                functions += function;
+            else
+                result.onlyInA += function;
+        }
+        foreach (const QString &function, functionsB) {
+            if (functionsA.contains(function) == false)
+                result.onlyInB += function;
+        }
+        if (result.onlyInA.isEmpty() == false)
+            result.status.output += "only in A, not compared: " + result.onlyInA.join(" ").toLocal8Bit() + "\n";
+        if (result.onlyInB.isEmpty() == false)
+            result.status.output += "only in B, not compared: " + result.onlyInB.join(" ").toLocal8Bit() + "\n";
+    }
+    if (functions.isEmpty())
+        functions += QString();
+
+    bool propertiesStored = false;
+
+    foreach (const QString &function, functions) {
+        for (int round = 0; round < options.rounds; ++round) {
+            const bool bFirst = QRandomGenerator::global()->bounded(2);
+            QHash<QString, BenchmarkValue> values[2];
+            for (int i = 0; i < 2; ++i) {
+                const bool runB = (i == 0) == bFirst;
+                const InterleavedBenchmark &benchmark = runB ? b : a;
+                QList<BenchmarkValue> runValues;
+                RunStatus status = runBenchmarkOnce(benchmark.workdir, benchmark.executable, options.runOptions,
+                                                    options.arguments, function, benchmark.runLabel, &runValues);
+                foreach (const BenchmarkValue &value, runValues)
+                    values[runB].insert(value.key(), value);
+                if (status.ok() == false) {
+                    result.status = status;
+                    return result;
+                }
+                if (propertiesStored == false) {
+                    // Both builds run on the same machine in the same conditions.
+                    if (a.runLabel.isEmpty() == false)
+                        addRunProperties(a.runLabel, status.properties);
+                    if (b.runLabel.isEmpty() == false)
+                        addRunProperties(b.runLabel, status.properties);
+                    result.status.properties = status.properties;
+                    propertiesStored = true;
+                }
+            }
+
+            // Only values both runs have can be paired.
+            QHash<QString, BenchmarkValue>::const_iterator it;
+            for (it = values[0].constBegin(); it != values[0].constEnd(); ++it) {
+                if (values[1].contains(it.key()) == false)
+                    continue;
+                PairedComparison &comparison = result.comparisons[it.key()];
+                comparison.function = it.value().function;
+                comparison.tag = it.value().tag;
+                comparison.metric = it.value().metric;
+                comparison.a += it.value().value;
+                comparison.b += values[1].value(it.key()).value;
+            }
+        }
+    }
+
+    QMap<QString, PairedComparison>::iterator it;
+    for (it = result.comparisons.begin(); it != result.comparisons.end(); ++it) {
+        PairedComparison &comparison = it.value();
+        QList<qreal> ratios;
+        for (int i = 0; i < comparison.a.count(); ++i)
+            ratios += comparison.a.at(i) == 0 ? 0 : comparison.b.at(i) / comparison.a.at(i);
+        comparison.ratio = geometricMean(ratios, options.confidence);
+        comparison.pValue = pairedTTest(comparison.a, comparison.b);
+
+        result.status.output += QString("%1: B/A %2 [%3, %4], p = %5\n")
+            .arg(it.key())
+            .arg(comparison.ratio.value, 0, 'f', 4)
+            .arg(comparison.ratio.lower, 0, 'f', 4)
+            .arg(comparison.ratio.upper, 0, 'f', 4)
+            .arg(comparison.pValue, 0, 'g', 3).toLocal8Bit();
+    }
+    return result;
+}
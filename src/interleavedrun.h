@@ -0,0 +1,89 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef INTERLEAVEDRUN_H
+#define INTERLEAVEDRUN_H
+
+#include <QtCore>
+#include "buildrun.h"
+#include "statistics.h"
+
+// A benchmark executable to be compared; runLabel is the label its results are stored
+// under in the open results database, or empty to not store them.
+class InterleavedBenchmark
+{
+public:
+    QString workdir;
+    QString executable;
+    QString runLabel;
+};
+
+// Options for comparing two builds of a benchmark by alternating their runs. Each of
+// rounds rounds runs A once and B once, in random order, so slow drift like thermal
+// throttling or background load affects both about equally. With perFunction, rounds
+// are done per test function, keeping the runs of a pair close together in time; only
+// the functions that both builds have are run.
+// arguments are passed on to every run.
+class InterleavedRunOptions
+{
+public:
+    InterleavedRunOptions()
+    : rounds(10), perFunction(true), confidence(0.95) { }
+    int rounds;
+    bool perFunction;
+    qreal confidence;
+    QStringList arguments;
+    RunOptions runOptions;
+};
+
+// The paired comparison of one function/tag/metric: the per iteration values of A and
+// B, in round order, the geometric mean of the per round ratios B/A with its confidence
+// interval, and the p-value of a paired t-test between them.
+class PairedComparison
+{
+public:
+    PairedComparison() : pValue(1) { }
+    QString function;
+    QString tag;
+    QString metric;
+    QList<qreal> a;
+    QList<qreal> b;
+    GeometricMean ratio;
+    qreal pValue;
+};
+
+// The status of the whole run (the first failure, if any, with a summary as output), the
+// comparisons keyed by noiseKey() and, with perFunction, the test functions that only
+// one of the builds has and that were therefore not run.
+class InterleavedRunResult
+{
+public:
+    RunStatus status;
+    QMap<QString, PairedComparison> comparisons;
+    QStringList onlyInA;
+    QStringList onlyInB;
+};
+
+InterleavedRunResult runBenchmarksInterleaved(const InterleavedBenchmark &a, const InterleavedBenchmark &b,
+                                              const InterleavedRunOptions &options = InterleavedRunOptions());
+
+#endif
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "noisemodel.h"
+#include "database.h"
+#include "statistics.h"
+
+// Relative changes below the noise floor are indistinguishable from run-to-run
+// noise: three robust standard deviations, or the 95th percentile of the
+// changes seen between consecutive runs, whichever is larger.
+qreal NoiseStats::noiseFloor() const
+{
+    if (!isValid())
+        return 0;
+    return qMax(3 * 1.4826 * relativeMad, runToRun95);
+}
+
+// A change counts only when it is larger than the noise floor.
+bool NoiseStats::isBeyondNoise(qreal relativeChange) const
+{
+    return isValid() && qAbs(relativeChange) > noiseFloor();
+}
+
+QString noiseKey(const QString &function, const QString &tag, const QString &metric)
+{
+    return function + tag + "/" + metric;
+}
+
+// Computes the noise statistics of one function/tag/metric from its values in
+// chronological run order. A benchmark is quarantined when its robust
+// coefficient of variation (1.4826 MAD / median) exceeds quarantineThreshold,
+// or its plain coefficient of variation exceeds twice that, i.e. when it is
+// either noisy throughout or prone to large outliers.
+NoiseStats computeNoiseStats(const QList<qreal> &runValues, qreal quarantineThreshold)
+{
+    NoiseStats stats;
+    stats.runs = runValues.count();
+    stats.median = median(runValues);
+    if (!stats.isValid() || stats.median == 0)
+        return stats;
+
+    const qreal scale = qAbs(stats.median);
+    stats.coefficientOfVariation = standardDeviation(runValues) / qAbs(mean(runValues));
+    stats.relativeMad = medianAbsoluteDeviation(runValues) / scale;
+
+    QList<qreal> runToRun;
+    for (int i = 1; i < runValues.count(); ++i)
+        runToRun += qAbs(runValues.at(i) - runValues.at(i - 1)) / scale;
+    stats.runToRunMedian = median(runToRun);
+    stats.runToRun95 = percentile(runToRun, 0.95);
+
+    const qreal previousMedian = median(runValues.mid(0, runValues.count() - 1));
+    if (previousMedian != 0)
+        stats.lastChange = (runValues.last() - previousMedian) / qAbs(previousMedian);
+
+    stats.quarantined = 1.4826 * stats.relativeMad > quarantineThreshold
+                        || stats.coefficientOfVariation > 2 * quarantineThreshold;
+    return stats;
+}
+
+// Computes the noise model of every function/tag/metric in \a tableName. Each run
+// (RunLabel) contributes the median of its values, so repeated results within a
+// run do not count as run-to-run noise.
+NoiseModel computeNoiseModel(const QString &tableName, qreal quarantineThreshold)
+{
+    QSqlQuery query;
+    query.prepare("SELECT TestCaseName, Series, Idx, Metric, Result, RunLabel FROM " + tableName + " ORDER BY rowid");
+    execQuery(query);
+
+    QStringList keys;
+    QHash<QString, QStringList> runLabels;
+    QHash<QString, QHash<QString, QList<qreal> > > values;
+    while (query.next()) {
+        const QString series = query.value(1).toString();
+        const QString index = query.value(2).toString();
+        const QString tag = resultTag(series, index);
+        const QString key = noiseKey(query.value(0).toString(), tag, query.value(3).toString());
+        const QString runLabel = query.value(5).toString();
+
+        if (!values.contains(key))
+            keys += key;
+        QHash<QString, QList<qreal> > &runValues = values[key];
+        if (!runValues.contains(runLabel))
+            runLabels[key] += runLabel;
+        runValues[runLabel] += query.value(4).toDouble();
+    }
+
+    NoiseModel model;
+    foreach (const QString &key, keys) {
+        QList<qreal> runValues;
+        foreach (const QString &runLabel, runLabels.value(key))
+            runValues += median(values.value(key).value(runLabel));
+        model.insert(key, computeNoiseStats(runValues, quarantineThreshold));
+    }
+    return model;
+}
@@ -0,0 +1,58 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef NOISEMODEL_H
+#define NOISEMODEL_H
+
+#include <QtCore>
+
+// Run-to-run noise of one function/tag/metric, computed from the per-run
+// values stored in a results table. Relative quantities are fractions of the
+// median (0.02 means 2%).
+struct NoiseStats
+{
+    NoiseStats()
+    : runs(0), median(0), coefficientOfVariation(0), relativeMad(0),
+      runToRunMedian(0), runToRun95(0), lastChange(0), quarantined(false) { }
+    int runs;
+    qreal median;
+    qreal coefficientOfVariation;
+    qreal relativeMad;
+    qreal runToRunMedian;   // median relative change between consecutive runs
+    qreal runToRun95;       // 95th percentile of the same
+    qreal lastChange;       // change of the last run from the median of the runs before it
+    bool quarantined;
+
+    bool isValid() const { return runs >= minimumRuns; }
+    qreal noiseFloor() const;
+    bool isBeyondNoise(qreal relativeChange) const;
+
+    enum { minimumRuns = 3 };
+};
+
+typedef QHash<QString, NoiseStats> NoiseModel;
+
+QString noiseKey(const QString &function, const QString &tag, const QString &metric);
+NoiseStats computeNoiseStats(const QList<qreal> &runValues, qreal quarantineThreshold = 0.1);
+NoiseModel computeNoiseModel(const QString &tableName = QString("Results"), qreal quarantineThreshold = 0.1);
+
+#endif
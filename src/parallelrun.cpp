@@ -0,0 +1,277 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "parallelrun.h"
+#include "processrunner.h"
+#include "adaptiverun.h"
+#include "database.h"
+
+/*
+    Runs benchmarks as many processes at once. This is only sound for metrics that do
+    not depend on the time things take, such as callgrind's instruction counts: timing
+    metrics measured in parallel mostly measure the contention between the processes.
+*/
+
+bool ParallelRunResult::ok() const
+{
+    foreach (RunStatus status, statuses) {
+        if (status.ok() == false)
+            return false;
+    }
+    return true;
+}
+
+// Returns one job per test function of \a executable, leaving out initTestCase and
+// cleanupTestCase, which run as part of every job anyway.
+QList<BenchmarkJob> functionJobs(const QString &executable)
+{
+    const QString workdir = QFileInfo(executable).absolutePath();
+    QList<BenchmarkJob> jobs;
+    foreach (QString function, benchmarkFunctions(workdir, executable)) {
+        BenchmarkJob job;
+        job.workdir = workdir;
+        job.executable = executable;
+        job.functions += function;
+        jobs += job;
+    }
+    return jobs;
+}
+
+static QString testCaseName(const QByteArray &document)
+{
+    QXmlStreamReader reader(document);
+    while (reader.atEnd() == false) {
+        reader.readNext();
+        if (reader.isStartElement() && reader.name() == "TestCase")
+            return reader.attributes().value("name").toString();
+    }
+    return QString();
+}
+
+ParallelRunResult runBenchmarksParallel(const QList<BenchmarkJob> &jobs, const ParallelRunOptions &options)
+{
+    // Every job writes its results to a file of its own; standard output is free for
+    // whatever else the benchmark and valgrind print.
+    QList<QTemporaryFile *> resultFiles;
+    ProcessRunner runner(options.concurrency);
+    QList<int> ids;
+    foreach (BenchmarkJob job, jobs) {
+        QTemporaryFile *resultFile = new QTemporaryFile;
+        resultFile->open();
+        resultFile->close();
+        resultFiles += resultFile;
+
+        ProcessJob processJob;
+        processJob.workdir = job.workdir;
+        processJob.executable = job.executable;
+        processJob.arguments = options.arguments;
+        processJob.arguments << "-xml" << "-o" << resultFile->fileName() << job.functions;
+        processJob.timeout = options.timeout;
+        ids += runner.addJob(processJob);
+    }
+    runner.waitForDone();
+
+    ParallelRunResult result;
+    QMap<QString, QList<QByteArray> > documents;
+    for (int i = 0; i < jobs.count(); ++i) {
+        const RunStatus status = runner.status(ids.at(i));
+        result.statuses += status;
+        if (status.ok() == false) {
+            qDebug() << "FAILED:" << jobs.at(i).executable << jobs.at(i).functions.join(" ") << status.output;
+            continue;
+        }
+        QFile resultFile(resultFiles.at(i)->fileName());
+        resultFile.open(QIODevice::ReadOnly);
+        const QByteArray document = resultFile.readAll();
+        documents[testCaseName(document)] += document;
+    }
+    qDeleteAll(resultFiles);
+
+    QMap<QString, QList<QByteArray> >::const_iterator it;
+    for (it = documents.constBegin(); it != documents.constEnd(); ++it)
+        result.results.insert(it.key(), mergeResultXml(it.value()));
+    return result;
+}
+
+// Runs every test function of every executable under callgrind, \a concurrency at a time.
+ParallelRunResult runCallgrindParallel(const QStringList &executables, int concurrency)
+{
+    QList<BenchmarkJob> jobs;
+    foreach (QString executable, executables)
+        jobs += functionJobs(executable);
+
+    ParallelRunOptions options;
+    options.concurrency = concurrency;
+    options.arguments << "-callgrind";
+    return runBenchmarksParallel(jobs, options);
+}
+
+// Copies the element the reader is positioned at, with everything in it, to the writer.
+static void copyElement(QXmlStreamReader &reader, QXmlStreamWriter &writer)
+{
+    int depth = 0;
+    do {
+        writer.writeCurrentToken(reader);
+        if (reader.isStartElement())
+            ++depth;
+        else if (reader.isEndElement())
+            --depth;
+        if (depth > 0)
+            reader.readNext();
+    } while (depth > 0 && reader.atEnd() == false);
+}
+
+/*
+    Merges QTestLib XML documents of the same test case, e.g. the results of running its
+    test functions in separate processes, into one document. The environment is taken
+    from the first document; of test functions found in several documents (typically
+    initTestCase and cleanupTestCase), only the first occurrence is kept.
+*/
+QByteArray mergeResultXml(const QList<QByteArray> &documents)
+{
+    QByteArray merged;
+    QXmlStreamWriter writer(&merged);
+    writer.setAutoFormatting(true);
+    writer.writeStartDocument();
+
+    QSet<QString> functions;
+    bool testCaseWritten = false;
+    bool environmentWritten = false;
+    foreach (QByteArray document, documents) {
+        QXmlStreamReader reader(document);
+        while (reader.atEnd() == false) {
+            reader.readNext();
+            if (reader.isStartElement() == false)
+                continue;
+            if (reader.name() == "TestCase") {
+                if (testCaseWritten == false) {
+                    writer.writeStartElement("TestCase");
+                    writer.writeAttributes(reader.attributes());
+                    testCaseWritten = true;
+                }
+            } else if (reader.name() == "Environment") {
+                if (environmentWritten)
+                    reader.skipCurrentElement();
+                else
+                    copyElement(reader, writer);
+                environmentWritten = true;
+            } else if (reader.name() == "TestFunction") {
+                const QString function = reader.attributes().value("name").toString();
+                if (functions.contains(function)) {
+                    reader.skipCurrentElement();
+                } else {
+                    functions.insert(function);
+                    copyElement(reader, writer);
+                }
+            }
+        }
+        if (reader.hasError())
+            qDebug() << "merging results failed:" << reader.errorString();
+    }
+
+    writer.writeEndDocument(); // closes the TestCase element
+    return merged;
+}
+
+// Sharding
+
+// Returns false for the QTestLib backends that count events rather than measure time,
+// whose results do not change when processes compete for the CPU: callgrind and the
+// event counter. Every other backend, including walltime (the default), the tick counter
+// and the hardware counters of -perf, is sensitive. Of several backend options, QTestLib
+// uses the last one.
+bool isContentionSensitive(const QStringList &arguments)
+{
+    static const QStringList backends = QStringList() << "-callgrind" << "-eventcounter" << "-tickcounter" << "-perf";
+    static const QStringList contentionFree = QStringList() << "-callgrind" << "-eventcounter";
+    for (int i = arguments.count() - 1; i >= 0; --i) {
+        if (backends.contains(arguments.at(i)))
+            return !contentionFree.contains(arguments.at(i));
+    }
+    return true;
+}
+
+// Splits the test functions of \a executable into at most \a shards jobs, dealing them
+// out in turn so that neighbouring (often similar) functions end up in different shards.
+QList<BenchmarkJob> shardJobs(const QString &executable, int shards)
+{
+    const QList<BenchmarkJob> singleFunctionJobs = functionJobs(executable);
+    QList<BenchmarkJob> jobs;
+    for (int i = 0; i < qMin(qMax(1, shards), singleFunctionJobs.count()); ++i)
+        jobs += singleFunctionJobs.at(i);
+    for (int i = jobs.count(); i < singleFunctionJobs.count(); ++i)
+        jobs[i % jobs.count()].functions += singleFunctionJobs.at(i).functions;
+    return jobs;
+}
+
+// Runs all of \a executable in one process through runBenchmark(), so the pinning,
+// scheduling and preflight check of options.runOptions apply.
+static ParallelRunResult runBenchmarkSerially(const QString &executable, const ParallelRunOptions &options)
+{
+    QTemporaryFile resultFile;
+    resultFile.open();
+    resultFile.close();
+
+    ParallelRunResult result;
+    const RunStatus status = runBenchmark(QString(), QFileInfo(executable).absolutePath(), executable, options.runOptions,
+                                          options.timeout, QStringList() << options.arguments << "-xml" << "-o" << resultFile.fileName());
+    result.statuses += status;
+    if (status.ok() == false) {
+        qDebug() << "FAILED:" << executable << status.output;
+        return result;
+    }
+    QFile file(resultFile.fileName());
+    file.open(QIODevice::ReadOnly);
+    const QByteArray document = file.readAll();
+    result.results.insert(testCaseName(document), document);
+    return result;
+}
+
+/*
+    Runs the test functions of \a executable in \a shards worker processes at a time. This
+    is done only for the metrics that are not sensitive to contention (see
+    isContentionSensitive()); wall time and the like are measured serially instead, by a
+    single process running one function after the other as usual, with the run options
+    in \a options.
+*/
+ParallelRunResult runBenchmarkSharded(const QString &executable, int shards, const ParallelRunOptions &options)
+{
+    if (isContentionSensitive(options.arguments))
+        return runBenchmarkSerially(executable, options);
+
+    ParallelRunOptions shardOptions = options;
+    const QList<BenchmarkJob> jobs = shardJobs(executable, shards);
+    shardOptions.concurrency = jobs.count();
+    return runBenchmarksParallel(jobs, shardOptions);
+}
+
+// Loads the merged results of \a result into the open results database in a single
+// transaction, so a run is either stored completely or not at all.
+void loadResults(const ParallelRunResult &result, const QString &runLabel)
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QMap<QString, QByteArray>::const_iterator it;
+    for (it = result.results.constBegin(); it != result.results.constEnd(); ++it)
+        loadXml(it.value(), it.key(), runLabel);
+    db.commit();
+}
@@ -0,0 +1,73 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef PARALLELRUN_H
+#define PARALLELRUN_H
+
+#include <QtCore>
+#include "buildrun.h"
+
+// One process of a parallel run: a QTestLib benchmark executable, restricted to the
+// given test functions unless functions is empty.
+class BenchmarkJob
+{
+public:
+    QString workdir;
+    QString executable;
+    QStringList functions;
+};
+
+// concurrency is the number of processes running at a time, timeout applies to each of
+// them (in milliseconds, -1 for none) and arguments are passed on to all, e.g. "-callgrind".
+// runOptions apply to the benchmarks that runBenchmarkSharded() runs serially.
+class ParallelRunOptions
+{
+public:
+    ParallelRunOptions()
+    : concurrency(QThread::idealThreadCount()), timeout(-1) { }
+    int concurrency;
+    int timeout;
+    QStringList arguments;
+    RunOptions runOptions;
+};
+
+// The outcome of a parallel run: the status of each job, in job order, and the XML
+// results of all jobs merged into one document per test case.
+class ParallelRunResult
+{
+public:
+    QList<RunStatus> statuses;
+    QMap<QString, QByteArray> results;
+    bool ok() const;
+};
+
+QList<BenchmarkJob> functionJobs(const QString &executable);
+ParallelRunResult runBenchmarksParallel(const QList<BenchmarkJob> &jobs, const ParallelRunOptions &options = ParallelRunOptions());
+ParallelRunResult runCallgrindParallel(const QStringList &executables, int concurrency = QThread::idealThreadCount());
+QByteArray mergeResultXml(const QList<QByteArray> &documents);
+
+bool isContentionSensitive(const QStringList &arguments);
+QList<BenchmarkJob> shardJobs(const QString &executable, int shards);
+ParallelRunResult runBenchmarkSharded(const QString &executable, int shards, const ParallelRunOptions &options = ParallelRunOptions());
+void loadResults(const ParallelRunResult &result, const QString &runLabel = QString());
+
+#endif
@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "perfcounters.h"
+
+#ifdef Q_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+const char *perfCounterMetric(int counter)
+{
+    switch (counter) {
+    case CpuCyclesCounter:
+        return "CPUCycles";
+    case InstructionsCounter:
+        return "Instructions";
+    case BranchMissesCounter:
+        return "BranchMisses";
+    case CacheMissesCounter:
+        return "CacheMisses";
+    case TaskClockCounter:
+        return "TaskClockMilliseconds";
+    case PageFaultsCounter:
+        return "PageFaults";
+    case ContextSwitchesCounter:
+        return "ContextSwitches";
+    case CpuMigrationsCounter:
+        return "CPUMigrations";
+    default:
+        return "";
+    }
+}
+
+#ifdef Q_OS_LINUX
+static int openPerfCounter(int pid, quint32 type, quint64 config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+    if (fd == -1 && errno == EACCES) {
+        // perf_event_paranoid may only allow counting in user space.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+    }
+    return fd;
+}
+#endif
+
+quint64 openPerfCounters(int pid, int *fds)
+{
+    quint64 opened = 0;
+    for (int counter = 0; counter < PerfCounterCount; ++counter)
+        fds[counter] = -1;
+#ifdef Q_OS_LINUX
+    static const struct { quint32 type; quint64 config; } events[PerfCounterCount] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS }
+    };
+    for (int counter = 0; counter < PerfCounterCount; ++counter) {
+        fds[counter] = openPerfCounter(pid, events[counter].type, events[counter].config);
+        if (fds[counter] != -1)
+            opened |= Q_UINT64_C(1) << counter;
+    }
+#else
+    Q_UNUSED(pid);
+#endif
+    return opened;
+}
+
+quint64 readPerfCounters(int *fds, quint64 *values)
+{
+    quint64 read = 0;
+    for (int counter = 0; counter < PerfCounterCount; ++counter) {
+        values[counter] = 0;
+#ifdef Q_OS_LINUX
+        if (fds[counter] == -1)
+            continue;
+        quint64 data[3]; // value, time enabled, time running
+        if (::read(fds[counter], data, sizeof(data)) == ssize_t(sizeof(data)) && data[2] > 0) {
+            values[counter] = data[2] < data[1] ? quint64(double(data[0]) * data[1] / data[2]) : data[0];
+            read |= Q_UINT64_C(1) << counter;
+        }
+        close(fds[counter]);
+        fds[counter] = -1;
+#endif
+    }
+    return read;
+}
@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <QtCore>
+
+// Performance counters for a benchmark process, using perf_event_open() on Linux.
+// The hardware counters need a PMU that is exposed to the system (often not the case
+// in virtual machines) and a permissive perf_event_paranoid setting; the software
+// counters are available almost everywhere, so at least those are measured.
+enum PerfCounter {
+    CpuCyclesCounter,
+    InstructionsCounter,
+    BranchMissesCounter,
+    CacheMissesCounter,
+    TaskClockCounter,
+    PageFaultsCounter,
+    ContextSwitchesCounter,
+    CpuMigrationsCounter,
+    PerfCounterCount
+};
+
+const char *perfCounterMetric(int counter);
+
+// These are only plain system calls, so they can be used between fork and exec.
+// openPerfCounters() opens the counters that are available on the process \a pid,
+// disabled until it execs and following its threads and children; \a fds is set to -1
+// for the others. readPerfCounters() reads and closes them, scaling the values when
+// counters had to be multiplexed. Both return a bit mask of the counters in \a fds and
+// \a values, respectively.
+quint64 openPerfCounters(int pid, int *fds);
+quint64 readPerfCounters(int *fds, quint64 *values);
+
+#endif
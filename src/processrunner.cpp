@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "processrunner.h"
+
+ProcessRunner::ProcessRunner(int concurrency, QObject *parent)
+: QObject(parent), m_concurrency(qMax(1, concurrency)), m_killTimeout(5000), m_nextId(0)
+{
+}
+
+ProcessRunner::~ProcessRunner()
+{
+    m_pending.clear();
+    foreach (QProcess *process, m_running.keys()) {
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(-1);
+        delete process;
+    }
+}
+
+int ProcessRunner::concurrency() const
+{
+    return m_concurrency;
+}
+
+void ProcessRunner::setConcurrency(int concurrency)
+{
+    m_concurrency = qMax(1, concurrency);
+    startJobs();
+}
+
+int ProcessRunner::killTimeout() const
+{
+    return m_killTimeout;
+}
+
+void ProcessRunner::setKillTimeout(int killTimeout)
+{
+    m_killTimeout = killTimeout;
+}
+
+// Queues \a job and starts it right away if fewer than concurrency() jobs are running.
+// Returns the id of the job.
+int ProcessRunner::addJob(const ProcessJob &job)
+{
+    const int id = m_nextId++;
+    m_pending.enqueue(qMakePair(id, job));
+    startJobs();
+    return id;
+}
+
+bool ProcessRunner::isDone() const
+{
+    return m_pending.isEmpty() && m_running.isEmpty();
+}
+
+// Runs an event loop until all jobs have finished.
+void ProcessRunner::waitForDone()
+{
+    if (isDone())
+        return;
+    QEventLoop loop;
+    connect(this, SIGNAL(done()), &loop, SLOT(quit()));
+    loop.exec();
+}
+
+RunStatus ProcessRunner::status(int job) const
+{
+    return m_statuses.value(job);
+}
+
+QHash<int, RunStatus> ProcessRunner::statuses() const
+{
+    return m_statuses;
+}
+
+void ProcessRunner::startJobs()
+{
+    while (m_running.count() < m_concurrency && m_pending.isEmpty() == false) {
+        const QPair<int, ProcessJob> pending = m_pending.dequeue();
+        const ProcessJob &job = pending.second;
+
+        QProcess *process = new QProcess(this);
+        process->setProcessChannelMode(job.channelMode);
+        if (job.workdir != QString())
+            process->setWorkingDirectory(job.workdir);
+        if (job.environment.isEmpty() == false)
+            process->setEnvironment(job.environment);
+        connect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(processOutput()));
+        connect(process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(processFinished()));
+        connect(process, SIGNAL(errorOccurred(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+
+        RunningJob running;
+        running.id = pending.first;
+        running.executable = job.executable;
+        if (job.timeout >= 0) {
+            running.timer = new QTimer(process);
+            running.timer->setSingleShot(true);
+            connect(running.timer, SIGNAL(timeout()), this, SLOT(processTimedOut()));
+            running.timer->start(job.timeout);
+        }
+        m_running.insert(process, running);
+
+        process->start(job.executable, job.arguments);
+    }
+}
+
+void ProcessRunner::finishJob(QProcess *process, const RunStatus &status)
+{
+    const RunningJob running = m_running.take(process);
+    if (running.timer)
+        running.timer->stop();
+    process->disconnect(this);
+    process->deleteLater();
+
+    m_statuses.insert(running.id, status);
+    emit jobFinished(running.id);
+
+    startJobs();
+    if (isDone())
+        emit done();
+}
+
+// Collects the output as it arrives, so a chatty job does not pile it up in the
+// process buffer until it finishes.
+void ProcessRunner::processOutput()
+{
+    QProcess *process = qobject_cast<QProcess *>(sender());
+    if (!process || !m_running.contains(process))
+        return;
+    m_running[process].output += process->readAllStandardOutput();
+}
+
+void ProcessRunner::processFinished()
+{
+    QProcess *process = qobject_cast<QProcess *>(sender());
+    if (!process || !m_running.contains(process))
+        return;
+
+    RunStatus status;
+    if (process->processChannelMode() != QProcess::ForwardedChannels)
+        status.output = m_running.value(process).output + process->readAllStandardOutput();
+
+    const QString executable = m_running.value(process).executable;
+    if (m_running.value(process).timedOut) {
+        status.error = RunStatus::TimeoutError;
+        status.output += "\n" + executable.toLocal8Bit() + " timed out and was killed\n";
+    } else if (process->exitStatus() == QProcess::CrashExit) {
+        status.error = RunStatus::CrashError;
+        status.output += "\n" + executable.toLocal8Bit() + " crashed\n";
+    } else {
+        status.exitCode = process->exitCode();
+        if (status.exitCode != 0)
+            status.error = RunStatus::RuntimeError;
+    }
+    finishJob(process, status);
+}
+
+// Crashes are handled when the process finishes; a process that does not start never
+// finishes, so it is dealt with here.
+void ProcessRunner::processError(QProcess::ProcessError error)
+{
+    QProcess *process = qobject_cast<QProcess *>(sender());
+    if (!process || !m_running.contains(process) || error != QProcess::FailedToStart)
+        return;
+
+    RunStatus status;
+    status.error = RunStatus::NotFoundError;
+    status.output = "Running " + m_running.value(process).executable.toLocal8Bit() + " failed with error string: "
+                    + process->errorString().toLocal8Bit();
+    finishJob(process, status);
+}
+
+// The first timeout asks the process to terminate, the second one kills it.
+void ProcessRunner::processTimedOut()
+{
+    QTimer *timer = qobject_cast<QTimer *>(sender());
+    QProcess *process = timer ? qobject_cast<QProcess *>(timer->parent()) : 0;
+    if (!process || !m_running.contains(process))
+        return;
+
+    RunningJob &running = m_running[process];
+    if (running.timedOut) {
+        process->kill();
+        return;
+    }
+    running.timedOut = true;
+    process->terminate();
+    timer->start(m_killTimeout);
+}
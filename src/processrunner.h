@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef PROCESSRUNNER_H
+#define PROCESSRUNNER_H
+
+#include <QtCore>
+#include "buildrun.h"
+
+// A process to be run by ProcessRunner. timeout is in milliseconds, -1 for none. The
+// output of the process is collected in RunStatus::output with MergedChannels (the
+// default) or SeparateChannels (standard output only), and passed on with
+// ForwardedChannels. An empty environment means the runner's environment.
+class ProcessJob
+{
+public:
+    ProcessJob()
+    : timeout(-1), channelMode(QProcess::MergedChannels) { }
+    QString workdir;
+    QString executable;
+    QStringList arguments;
+    QStringList environment;
+    int timeout;
+    QProcess::ProcessChannelMode channelMode;
+};
+
+/*
+    Runs many processes at once without blocking, at most concurrency() at a time, for
+    work that does not measure time itself: builds, callgrind runs and the like. Jobs
+    are started in the order they were added. A job that runs longer than its timeout
+    is asked to terminate and killed if it is still running killTimeout() milliseconds
+    later. Each job ends with a RunStatus that tells a failure to start, a non-zero
+    exit code, a crash and a timeout apart.
+*/
+class ProcessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    ProcessRunner(int concurrency = QThread::idealThreadCount(), QObject *parent = 0);
+    ~ProcessRunner();
+
+    int concurrency() const;
+    void setConcurrency(int concurrency);
+    int killTimeout() const;
+    void setKillTimeout(int killTimeout);
+
+    int addJob(const ProcessJob &job);
+    bool isDone() const;
+    void waitForDone();
+
+    RunStatus status(int job) const;
+    QHash<int, RunStatus> statuses() const;
+
+signals:
+    void jobFinished(int job);
+    void done();
+
+private slots:
+    void processOutput();
+    void processFinished();
+    void processError(QProcess::ProcessError error);
+    void processTimedOut();
+
+private:
+    struct RunningJob {
+        RunningJob() : id(-1), timer(0), timedOut(false) { }
+        int id;
+        QString executable;
+        QTimer *timer;
+        bool timedOut;
+        QByteArray output;
+    };
+
+    void startJobs();
+    void finishJob(QProcess *process, const RunStatus &status);
+
+    int m_concurrency;
+    int m_killTimeout;
+    int m_nextId;
+    QQueue<QPair<int, ProcessJob> > m_pending;
+    QHash<QProcess *, RunningJob> m_running;
+    QHash<int, RunStatus> m_statuses;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "processusage.h"
+
+// The usage as metric name/value pairs, named like the QTestLib metrics. Instructions
+// per cycle and misses per thousand instructions are derived from the counters when
+// those were measured.
+QList<QPair<QString, qreal> > ProcessUsage::metrics() const
+{
+    QList<QPair<QString, qreal> > metrics;
+    if (valid == false)
+        return metrics;
+
+    QMap<QString, qreal>::const_iterator it;
+    for (it = counters.constBegin(); it != counters.constEnd(); ++it)
+        metrics << qMakePair(it.key(), it.value());
+    const qreal instructions = counters.value("Instructions");
+    if (instructions > 0) {
+        if (counters.value("CPUCycles") > 0)
+            metrics << qMakePair(QString("InstructionsPerCycle"), instructions / counters.value("CPUCycles"));
+        if (counters.contains("BranchMisses"))
+            metrics << qMakePair(QString("BranchMissesPerKiloInstruction"), counters.value("BranchMisses") * 1000 / instructions);
+        if (counters.contains("CacheMisses"))
+            metrics << qMakePair(QString("CacheMissesPerKiloInstruction"), counters.value("CacheMisses") * 1000 / instructions);
+    }
+
+    metrics << qMakePair(QString("MaxResidentKilobytes"), qreal(maxResidentKilobytes))
+            << qMakePair(QString("MinorPageFaults"), qreal(minorFaults))
+            << qMakePair(QString("MajorPageFaults"), qreal(majorFaults))
+            << qMakePair(QString("VoluntaryContextSwitches"), qreal(voluntaryContextSwitches))
+            << qMakePair(QString("InvoluntaryContextSwitches"), qreal(involuntaryContextSwitches))
+            << qMakePair(QString("UserTimeMilliseconds"), userTime)
+            << qMakePair(QString("SystemTimeMilliseconds"), systemTime);
+    return metrics;
+}
+
+// Returns the usage as QTestLib XML with one BenchmarkResult per metric, in a test
+// function called "processUsage", so it can be loaded, reported and compared like the
+// results of the benchmark itself. \a tag tells processes of the same test case apart,
+// e.g. when test functions are run one at a time.
+QByteArray ProcessUsage::toXml(const QString &testCase, const QString &tag) const
+{
+    QByteArray xml;
+    QXmlStreamWriter writer(&xml);
+    writer.setAutoFormatting(true);
+    writer.writeStartDocument();
+    writer.writeStartElement("TestCase");
+    writer.writeAttribute("name", testCase);
+    writer.writeStartElement("TestFunction");
+    writer.writeAttribute("name", "processUsage");
+    QPair<QString, qreal> metric;
+    foreach (metric, metrics()) {
+        writer.writeStartElement("BenchmarkResult");
+        writer.writeAttribute("metric", metric.first);
+        writer.writeAttribute("tag", tag);
+        writer.writeAttribute("value", QString::number(metric.second, 'g', 17));
+        writer.writeAttribute("iterations", "1");
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return xml;
+}
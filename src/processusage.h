@@ -0,0 +1,52 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef PROCESSUSAGE_H
+#define PROCESSUSAGE_H
+
+#include <QtCore>
+
+// Resource usage of a benchmark process as reported by wait4() when it is reaped.
+// Times are in milliseconds, the maximum resident set size in kilobytes. counters
+// holds the performance counters that could be measured (see perfcounters.h), by
+// metric name.
+class ProcessUsage
+{
+public:
+    ProcessUsage()
+    : valid(false), maxResidentKilobytes(0), minorFaults(0), majorFaults(0),
+      voluntaryContextSwitches(0), involuntaryContextSwitches(0), userTime(0), systemTime(0) { }
+    bool valid;
+    qint64 maxResidentKilobytes;
+    qint64 minorFaults;
+    qint64 majorFaults;
+    qint64 voluntaryContextSwitches;
+    qint64 involuntaryContextSwitches;
+    qreal userTime;
+    qreal systemTime;
+    QMap<QString, qreal> counters;
+
+    QList<QPair<QString, qreal> > metrics() const;
+    QByteArray toXml(const QString &testCase, const QString &tag = QString()) const;
+};
+
+#endif
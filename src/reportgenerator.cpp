@@ -1,4 +1,6 @@
 #include "reportgenerator.h"
+#include "noisemodel.h"
+#include "environment.h"
 
 // Report generator file utility functions
 
@@ -199,13 +201,91 @@ QByteArray printSeriesLabels(const QString &tableName, const QString &seriesColu
     output += "[";
     
     foreach(const QString &serie, series) {
-        output += "\"" + serie.toLocal8Bit() + "\", ";
+        output += "\"" + serie.toUtf8() + "\", ";
     }
     output.chop(1); //remove last comma
     output += "]\n";
     return output;
 }
 
+// The rows of the noise table for the benchmarks in \a tableName, see printNoiseTable().
+static QList<QByteArray> printNoiseRows(const QString &tableName)
+{
+    NoiseModel model = computeNoiseModel(tableName);
+    QStringList keys = model.keys();
+    keys.sort();
+
+    QList<QByteArray> output;
+    foreach (const QString &key, keys) {
+        const NoiseStats stats = model.value(key);
+        if (!stats.isValid())
+            continue;
+        QString lastChange = QString("%1%").arg(stats.lastChange * 100, 0, 'f', 1);
+        if (stats.isBeyondNoise(stats.lastChange))
+            lastChange = "<b>" + lastChange + "</b>";
+        output.append(QString("<tr><td>%1</td><td>%2</td><td>%3%</td><td>%4%</td><td>%5%</td><td>%6%</td><td>%7%</td><td>%8</td><td>%9</td></tr>\n")
+                      .arg(key.toHtmlEscaped()).arg(stats.runs)
+                      .arg(stats.coefficientOfVariation * 100, 0, 'f', 1)
+                      .arg(stats.relativeMad * 100, 0, 'f', 1)
+                      .arg(stats.runToRunMedian * 100, 0, 'f', 1)
+                      .arg(stats.runToRun95 * 100, 0, 'f', 1)
+                      .arg(stats.noiseFloor() * 100, 0, 'f', 1)
+                      .arg(lastChange)
+                      .arg(stats.quarantined ? QString("<b>quarantine</b>") : QString()).toUtf8());
+    }
+    return output;
+}
+
+static QList<QByteArray> noiseTable(QList<QByteArray> output)
+{
+    if (output.isEmpty())
+        return output;
+
+    output.prepend("<h3>Run-to-run noise</h3>\n<table cellspacing = \"10\">\n"
+                   "<tr><th>Benchmark</th><th>Runs</th><th>CV</th><th>MAD</th>"
+                   "<th>Run-to-run (median)</th><th>Run-to-run (95%)</th><th>Noise floor</th><th>Last run</th><th></th></tr>\n");
+    output.append("</table>\n");
+    return output;
+}
+
+// Lists the run-to-run noise of every benchmark with enough history, flagging
+// the noisy ones for quarantine. The change of the last run is shown in bold when it
+// is beyond the noise floor.
+QList<QByteArray> printNoiseTable(const QString &tableName)
+{
+    return noiseTable(printNoiseRows(tableName));
+}
+
+// Lists how and where each of \a runLabels ran (the properties stored with
+// addRunProperties(), such as the environment fingerprint and the CPU affinity) and
+// the settings known to make results noisy, so outliers can be explained.
+QList<QByteArray> printRunProperties(const QStringList &runLabels)
+{
+    QList<QByteArray> output;
+    foreach (const QString &runLabel, runLabels) {
+        const QHash<QString, QString> properties = runProperties(runLabel);
+        if (properties.isEmpty())
+            continue;
+        QStringList names = properties.keys();
+        names.sort();
+        QStringList values;
+        foreach (const QString &name, names)
+            values += (name + "=" + properties.value(name)).toHtmlEscaped();
+        QStringList warnings;
+        foreach (const QString &warning, environmentWarnings(properties))
+            warnings += warning.toHtmlEscaped();
+        output.append(QString("<tr><td valign=\"top\">%1</td><td>%2</td><td valign=\"top\"><b>%3</b></td></tr>\n")
+                      .arg(runLabel.toHtmlEscaped()).arg(values.join(", ")).arg(warnings.join("<br>")).toUtf8());
+    }
+    if (output.isEmpty())
+        return output;
+
+    output.prepend("<h3>Runs</h3>\n<table cellspacing = \"10\">\n"
+                   "<tr><th>Run</th><th>Properties</th><th>Warnings</th></tr>\n");
+    output.append("</table>\n");
+    return output;
+}
+
 void addJavascript(QList<QByteArray> *output, const QString &fileName)
 {
     output->append("<script type=\"text/javascript\">\n");
@@ -295,6 +375,21 @@ TempTable selectTestCase(const QString &testCase, const QString &sourceTable)
     return selectRows(sourceTable, QLatin1String("TestCaseName"), testCase);
 }
 
+// The results of \a testCase for one Qt version, without copying all of that version first.
+TempTable selectTestCase(const QString &testCase, const QString &sourceTable, const QString &qtVersion)
+{
+    TempTable tempTable(resultsTable);
+
+    QSqlQuery query;
+    query.prepare("INSERT INTO " + tempTable.name() + " SELECT * FROM " + sourceTable +
+                  " WHERE TestCaseName = :TestCaseName AND QtVersion = :QtVersion");
+    query.bindValue(":TestCaseName", testCase);
+    query.bindValue(":QtVersion", qtVersion);
+    execQuery(query);
+
+    return tempTable;
+}
+
 QString field(const QSqlQuery &query, const QString &name)
 {
     return query.value(query.record().indexOf(name)).toString();
@@ -351,39 +446,141 @@ ReportGenerator::ReportGenerator()
 void ReportGenerator::writeReport(const QString &tableName, const QString &fileName, bool combineQtVersions)
 {
     QStringList testCases = selectUnique("TestCaseName", tableName);
+    QList<QByteArray> charts;
+    foreach (const QString testCase, testCases) {
+        TempTable testCaseTable = selectTestCase(testCase, tableName);
+        charts += writeChart(testCaseTable.name(), combineQtVersions);
+    }
+
+    QStringList name = selectUnique("TestName", tableName);
+    QByteArray title = "Test: " + name.join("").toUtf8();
+    QList<QByteArray> description;
+    description += selectUnique("TestTitle", tableName).join("").toUtf8();
+
+    QStringList runLabels = selectUnique("RunLabel", tableName);
+    runLabels.sort();
+    writePage(fileName, title, description, charts, printNoiseTable(tableName) + printRunProperties(runLabels));
+}
+
+// Fills in the benchmark template and writes it to \a fileName.
+void ReportGenerator::writePage(const QString &fileName, const QByteArray &title, const QList<QByteArray> &description,
+                                const QList<QByteArray> &charts, const QList<QByteArray> &footer)
+{
+    m_fileName = fileName;
+
+    writeLines(m_fileName, page(title, description, charts, footer));
+    qDebug() << "wrote report to" << m_fileName;
+}
+
+// Returns the benchmark template filled in.
+QList<QByteArray> ReportGenerator::page(const QByteArray &title, const QList<QByteArray> &description,
+                                        const QList<QByteArray> &charts, const QList<QByteArray> &footer)
+{
     QList<QByteArray> lines = readLines(":benchmark_template.html");
     QList<QByteArray> output;
 
     foreach(QByteArray line, lines) {
         if (line.contains("<! Chart Here>")) {
-            foreach (const QString testCase, testCases) {
-                TempTable testCaseTable = selectTestCase(testCase, tableName);
-                output += writeChart(testCaseTable.name(), combineQtVersions);
-            }
+            output += charts;
          } else if (line.contains("<! Title Here>")) {
-            QStringList name = selectUnique("TestName", tableName);
-            output += "Test: " + name.join("").toLocal8Bit();
+            output += title;
          } else if (line.contains("<! Description Here>")) {
-            output += selectUnique("TestTitle", tableName).join("").toLocal8Bit();
+            output += description;
+        } else if (line.contains("<! Noise Here>")) {
+            output += footer;
         } else if (line.contains("<! Javascript Here>")){
             addJavascript(&output);
          } else {
             output.append(line);
         }
     }
+    return output;
+}
 
-    m_fileName = fileName;
+// The chart of one test case, for one Qt version or with all versions combined.
+QList<QByteArray> ReportGenerator::testCaseChart(const QString &testCase, const QString &version)
+{
+    if (version.isEmpty()) {
+        TempTable testCaseTable = selectTestCase(testCase, "Results");
+        return writeChart(testCaseTable.name(), true);
+    }
+    TempTable testCaseTable = selectTestCase(testCase, "Results", version);
+    return writeChart(testCaseTable.name(), false);
+}
 
-    writeLines(m_fileName, output);
-    qDebug() << "wrote report to" << m_fileName;
+ReportGenerator::TestCasePart ReportGenerator::renderTestCase(const QString &testCase, const QString &version)
+{
+    TempTable testCaseTable = version.isEmpty() ? selectTestCase(testCase, "Results")
+                                                : selectTestCase(testCase, "Results", version);
+    TestCasePart part;
+    part.chart = writeChart(testCaseTable.name(), version.isEmpty());
+    part.noise = printNoiseRows(testCaseTable.name());
+    part.testNames = selectUnique("TestName", testCaseTable.name());
+    part.testTitles = selectUnique("TestTitle", testCaseTable.name());
+    part.runLabels = selectUnique("RunLabel", testCaseTable.name());
+    return part;
+}
+
+// Writes the report of \a version ("" for all versions combined) from the parts
+// rendered so far.
+void ReportGenerator::writeCachedPage(const QString &version)
+{
+    QList<QByteArray> charts;
+    QList<QByteArray> noise;
+    QStringList testNames;
+    QStringList testTitles;
+    QStringList runLabels;
+    foreach (const TestCasePart &part, m_pages.value(version)) {
+        charts += part.chart;
+        noise += part.noise;
+        testNames += part.testNames;
+        testTitles += part.testTitles;
+        runLabels += part.runLabels;
+    }
+    testNames.removeDuplicates();
+    testTitles.removeDuplicates();
+    runLabels.removeDuplicates();
+    runLabels.sort();
+
+    const QString fileName = version.isEmpty() ? QString("results.html") : "results-" + version + ".html";
+    QList<QByteArray> description;
+    description += testTitles.join("").toUtf8();
+    writePage(fileName, "Test: " + testNames.join("").toUtf8(), description, charts,
+              noiseTable(noise) + printRunProperties(runLabels));
+}
+
+/*
+    Renders the given test cases, as (Qt version, test case) pairs, again for their
+    version's report and the combined report, and rewrites these reports. The parts of
+    the other test cases are kept from earlier calls, so only what changed is read from
+    the database. The reports contain the test cases passed in so far, so the first call
+    should pass all of them.
+*/
+void ReportGenerator::updateReports(const QList<QPair<QString, QString> > &testCases)
+{
+    QSet<QString> versions;
+    QSet<QString> combined;
+    for (int i = 0; i < testCases.count(); ++i) {
+        const QString version = testCases.at(i).first;
+        const QString testCase = testCases.at(i).second;
+        m_pages[version][testCase] = renderTestCase(testCase, version);
+        versions.insert(version);
+        if (combined.contains(testCase) == false) {
+            m_pages[QString()][testCase] = renderTestCase(testCase, QString());
+            combined.insert(testCase);
+        }
+    }
+    if (testCases.isEmpty())
+        return;
+    versions.insert(QString());
+    foreach (const QString &version, versions)
+        writeCachedPage(version);
 }
 
 void ReportGenerator::writeReports()
 {
     QStringList versions = selectUnique("QtVersion", "Results");
 
- //   qDebug() << "versions" << versions;
-
     foreach (QString version, versions) {
         QString fileName = "results-"  + version  + ".html";
         TempTable versionTable = selectRows("Results", "QtVersion", version);
@@ -449,17 +646,17 @@ QList<QByteArray> ReportGenerator::writeChart(const QString &tableName, bool com
 
     foreach(QByteArray line, lines) {
         if (line.contains("<! Test Name Here>")) {
-            output.append(title.toLocal8Bit());
+            output.append(title.toUtf8());
         } else if (line.contains("<! Chart ID Here>")) {
-            output += chartId.toLocal8Bit();
+            output += chartId.toUtf8();
         } else if (line.contains("<! Form ID Here>")) {
-            output += formId.toLocal8Bit();
+            output += formId.toUtf8();
         } else if (line.contains("<! ChartTypeForm ID Here>")) {
-            output += chartTypeFormId.toLocal8Bit();    
+            output += chartTypeFormId.toUtf8();    
         } else if (line.contains("<! ScaleForm ID Here>")) {
-            output += scaleFormId.toLocal8Bit();    
+            output += scaleFormId.toUtf8();    
         } else if (line.contains("<! Size>")) {
-            output += sizeString.toLocal8Bit();
+            output += sizeString.toUtf8();
         } else if (line.contains("<! ColorScheme Here>")) {
             output += colors;
         } else if (line.contains("<! Data Goes Here>")) {
@@ -469,9 +666,9 @@ QList<QByteArray> ReportGenerator::writeChart(const QString &tableName, bool com
         } else if (line.contains("<! Use Line Chart Here>")) {
             output += useLineChartString + ";";
         } else if (line.contains("<! Chart Type Here>")) {
-            output += "\"" + type.toLocal8Bit() + "\"";
+            output += "\"" + type.toUtf8() + "\"";
         } else if (line.contains("<! Fill Setting Here>")) {
-            output += fillString.toLocal8Bit();            
+            output += fillString.toUtf8();            
         } else if (line.contains("<! Series Labels Here>")) {
             output += seriesLabels;
         } else {
@@ -488,7 +685,7 @@ QByteArray ReportGenerator::printColors(const QString &tableName, const QString
     int i = 0;
     QStringList series = selectUnique(seriesName, tableName);
     foreach (const QString &serie, series) {
-        colors.append("'" + serie.toLocal8Bit() + "': '" + m_colorScheme.at(i % m_colorScheme.count()) + "',\n");
+        colors.append("'" + serie.toUtf8() + "': '" + m_colorScheme.at(i % m_colorScheme.count()) + "',\n");
         ++ i;
     }
     colors.chop(2); // remove last comma
@@ -32,14 +32,37 @@ public:
 	QByteArray printColors(const QString &tableName, const QString &seriesName);
 	QList<QByteArray> writeChart(const QString &tableName, bool combineVersions);
     void writeReport(const QString &tableName, const QString &filename, bool combineVersions = false);
+    void writePage(const QString &fileName, const QByteArray &title, const QList<QByteArray> &description,
+                   const QList<QByteArray> &charts, const QList<QByteArray> &footer = QList<QByteArray>());
+    QList<QByteArray> page(const QByteArray &title, const QList<QByteArray> &description,
+                           const QList<QByteArray> &charts, const QList<QByteArray> &footer = QList<QByteArray>());
+    QList<QByteArray> testCaseChart(const QString &testCase, const QString &version = QString());
 	void writeReports();
+    void updateReports(const QList<QPair<QString, QString> > &testCases);
     QString fileName();
 private:
+    // The rendered parts of one test case on a report page.
+    struct TestCasePart
+    {
+        QList<QByteArray> chart;
+        QList<QByteArray> noise;
+        QStringList testNames;
+        QStringList testTitles;
+        QStringList runLabels;
+    };
+    TestCasePart renderTestCase(const QString &testCase, const QString &version);
+    void writeCachedPage(const QString &version);
+
 	QList<QByteArray> m_colorScheme;
     QString m_fileName;
+    QMap<QString, QMap<QString, TestCasePart> > m_pages; // by Qt version ("" for all), then test case
 };
 
 void printTestCaseResults(const QString &testCaseName);
+TempTable selectTestCase(const QString &testCase, const QString &sourceTable, const QString &qtVersion);
+QStringList selectUnique(const QString &field, const QString &tableName);
+QList<QByteArray> printNoiseTable(const QString &tableName);
+QList<QByteArray> printRunProperties(const QStringList &runLabels);
 
 #endif
 
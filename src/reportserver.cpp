@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "reportserver.h"
+
+static QByteArray join(const QList<QByteArray> &lines)
+{
+    QByteArray result;
+    foreach (const QByteArray &line, lines)
+        result += line;
+    return result;
+}
+
+ReportServer::ReportServer(QObject *parent)
+    : QTcpServer(parent), m_cache(32 * 1024 * 1024)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+}
+
+int ReportServer::cacheSize() const
+{
+    return m_cache.maxCost();
+}
+
+void ReportServer::setCacheSize(int bytes)
+{
+    m_cache.setMaxCost(bytes);
+}
+
+void ReportServer::acceptConnection()
+{
+    while (hasPendingConnections()) {
+        QTcpSocket *socket = nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+// Answers one request per connection once its header is complete. Only the request
+// line is used; the rest of the header is ignored.
+void ReportServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0 || socket->property("answered").toBool())
+        return;
+    QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+    if (request.contains("\r\n\r\n") == false && request.contains("\n\n") == false) {
+        if (request.size() > 64 * 1024)
+            socket->abort();
+        else
+            socket->setProperty("request", request);
+        return;
+    }
+    socket->setProperty("answered", true);
+
+    const QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (requestLine.count() < 2) {
+        status = "400 Bad Request";
+    } else if (requestLine.at(0) != "GET") {
+        status = "405 Method Not Allowed";
+    } else {
+        body = respond(requestLine.at(1), &status);
+    }
+    if (body.isEmpty())
+        body = "<html><body><h3>" + status + "</h3></body></html>\n";
+
+    socket->write("HTTP/1.0 " + status + "\r\n"
+                  "Content-Type: text/html; charset=utf-8\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Connection: close\r\n\r\n");
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+// Changes whenever results are added, so cached payloads can be dropped. Results are
+// only ever appended, and MAX(rowid) is a lookup in the rowid b-tree, not a scan.
+QString ReportServer::dataVersion()
+{
+    QSqlQuery query;
+    query.prepare("SELECT MAX(rowid) FROM Results");
+    execQuery(query);
+    if (query.next() == false)
+        return QString();
+    return query.value(0).toString();
+}
+
+static bool hasResults(const QString &column, const QString &value)
+{
+    QSqlQuery query;
+    query.prepare("SELECT 1 FROM Results WHERE " + column + " = :Value LIMIT 1");
+    query.bindValue(":Value", value);
+    execQuery(query);
+    return query.next();
+}
+
+QByteArray ReportServer::respond(const QByteArray &path, QByteArray *status)
+{
+    const QUrl url = QUrl::fromEncoded(path);
+    const QUrlQuery query(url);
+    const QString version = query.queryItemValue("version", QUrl::FullyDecoded);
+    const QString testCase = query.queryItemValue("testcase", QUrl::FullyDecoded);
+
+    const QString currentDataVersion = dataVersion();
+    if (currentDataVersion != m_dataVersion) {
+        m_cache.clear();
+        m_dataVersion = currentDataVersion;
+    }
+
+    // The names end up in SQL and HTML, so only the ones in the database are accepted.
+    if ((version.isEmpty() == false && hasResults("QtVersion", version) == false)
+        || (url.path() == "/chart" && hasResults("TestCaseName", testCase) == false)) {
+        *status = "404 Not Found";
+        return QByteArray();
+    }
+
+    const QString key = url.path() + "\n" + version + "\n" + testCase;
+    if (QByteArray *cached = m_cache.object(key))
+        return *cached;
+
+    QByteArray payload;
+    if (url.path() == "/") {
+        payload = reportPage(version);
+    } else if (url.path() == "/chart") {
+        payload = join(m_reportGenerator.testCaseChart(testCase, version));
+    } else if (url.path() == "/noise") {
+        payload = join(printNoiseTable("Results"));
+        if (payload.isEmpty())
+            payload = "<p>Not enough runs for noise statistics.</p>\n";
+    } else if (url.path() == "/runs") {
+        QStringList runLabels = selectUnique("RunLabel", "Runs");
+        runLabels.sort();
+        payload = join(printRunProperties(runLabels));
+        if (payload.isEmpty())
+            payload = "<p>No run properties recorded.</p>\n";
+    } else {
+        *status = "404 Not Found";
+        return QByteArray();
+    }
+
+    m_cache.insert(key, new QByteArray(payload), payload.size());
+    return payload;
+}
+
+// The report page without any chart data: a placeholder per test case that loads the
+// chart when it is opened.
+QByteArray ReportServer::reportPage(const QString &version)
+{
+    const QByteArray versionQuery = version.isEmpty() ? QByteArray() : "&version=" + QUrl::toPercentEncoding(version);
+
+    QList<QByteArray> description;
+    description += "<script type=\"text/javascript\">\n"
+                   "function loadChart(id, url)\n"
+                   "{\n"
+                   "    $(id + 'link').hide();\n"
+                   "    new Ajax.Updater(id, url, { method: 'get', evalScripts: true });\n"
+                   "}\n"
+                   "</script>\n";
+    description += "<p>Qt version: ";
+    description += version.isEmpty() ? QByteArray("<b>all</b>") : QByteArray("<a href=\"/\">all</a>");
+    foreach (const QString &qtVersion, selectUnique("QtVersion", "Results")) {
+        if (qtVersion == version)
+            description += " <b>" + qtVersion.toHtmlEscaped().toUtf8() + "</b>";
+        else
+            description += " <a href=\"/?version=" + QUrl::toPercentEncoding(qtVersion) + "\">"
+                           + qtVersion.toHtmlEscaped().toUtf8() + "</a>";
+    }
+    description += "</p>\n";
+
+    QList<QByteArray> charts;
+    QStringList testCases = selectUnique("TestCaseName", "Results");
+    testCases.sort();
+    for (int i = 0; i < testCases.count(); ++i) {
+        const QByteArray id = "chart" + QByteArray::number(i);
+        const QByteArray chartUrl = "/chart?testcase=" + QUrl::toPercentEncoding(testCases.at(i)) + versionQuery;
+        charts += "<div id=\"" + id + "\"><h3>" + testCases.at(i).toHtmlEscaped().toUtf8()
+                  + " <a id=\"" + id + "link\" href=\"#\" onclick=\"loadChart('" + id + "', '" + chartUrl
+                  + "'); return false;\">show</a></h3></div>\n";
+    }
+
+    QList<QByteArray> footer;
+    footer += "<div id=\"noise\"><a id=\"noiselink\" href=\"#\" onclick=\"loadChart('noise', '/noise'); return false;\">"
+              "Run-to-run noise</a></div>\n";
+    footer += "<div id=\"runs\"><a id=\"runslink\" href=\"#\" onclick=\"loadChart('runs', '/runs'); return false;\">"
+              "Runs</a></div>\n";
+
+    QStringList names = selectUnique("TestName", "Results");
+    const QByteArray title = "Test: " + names.join(" ").toHtmlEscaped().toUtf8();
+    return join(m_reportGenerator.page(title, description, charts, footer));
+}
@@ -0,0 +1,68 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef REPORTSERVER_H
+#define REPORTSERVER_H
+
+#include <QtCore>
+#include <QtNetwork>
+#include "reportgenerator.h"
+
+/*
+    Serves the reports of the open results database over HTTP, so that the full history
+    does not have to go into one static page. The report page lists the test cases and
+    fetches the chart of each one from the server only when the viewer opens it:
+
+    /                       the report page with all Qt versions combined
+    /?version=<version>     the report page of one Qt version
+    /chart?testcase=<name>[&version=<version>]
+                            the chart of one test case, as an HTML fragment
+    /noise                  the run-to-run noise table
+    /runs                   the properties of the runs, e.g. their environment fingerprints
+
+    Rendered pages and charts are kept in a least recently used cache of at most
+    cacheSize bytes, which is emptied whenever results are added to the database. The
+    temporary tables a chart is rendered from are dropped once it is rendered.
+*/
+class ReportServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    ReportServer(QObject *parent = 0);
+    int cacheSize() const;
+    void setCacheSize(int bytes);
+
+private slots:
+    void acceptConnection();
+    void readRequest();
+
+private:
+    QByteArray respond(const QByteArray &path, QByteArray *status);
+    QByteArray reportPage(const QString &version);
+    QString dataVersion();
+
+    ReportGenerator m_reportGenerator;
+    QCache<QString, QByteArray> m_cache;
+    QString m_dataVersion;
+};
+
+#endif
@@ -0,0 +1,278 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include "statistics.h"
+#include <math.h>
+
+// Descriptive statistics
+
+qreal mean(const QList<qreal> &values)
+{
+    if (values.isEmpty())
+        return 0;
+    qreal sum = 0;
+    foreach (qreal value, values)
+        sum += value;
+    return sum / values.count();
+}
+
+qreal median(QList<qreal> values)
+{
+    if (values.isEmpty())
+        return 0;
+    qSort(values);
+    const int mid = values.count() / 2;
+    if (values.count() % 2)
+        return values.at(mid);
+    return (values.at(mid - 1) + values.at(mid)) / 2;
+}
+
+// Sample standard deviation (n - 1 in the denominator).
+qreal standardDeviation(const QList<qreal> &values)
+{
+    if (values.count() < 2)
+        return 0;
+    const qreal m = mean(values);
+    qreal sum = 0;
+    foreach (qreal value, values)
+        sum += (value - m) * (value - m);
+    return sqrt(sum / (values.count() - 1));
+}
+
+qreal minimum(const QList<qreal> &values)
+{
+    if (values.isEmpty())
+        return 0;
+    qreal result = values.first();
+    foreach (qreal value, values)
+        result = qMin(result, value);
+    return result;
+}
+
+// Median of the absolute deviations from the median; a spread estimate that,
+// unlike the standard deviation, is not thrown off by a few outliers.
+qreal medianAbsoluteDeviation(const QList<qreal> &values)
+{
+    const qreal m = median(values);
+    QList<qreal> deviations;
+    foreach (qreal value, values)
+        deviations += qAbs(value - m);
+    return median(deviations);
+}
+
+// Returns the \a p quantile (0 <= p <= 1), interpolating linearly between values.
+qreal percentile(QList<qreal> values, qreal p)
+{
+    if (values.isEmpty())
+        return 0;
+    qSort(values);
+    const qreal position = qBound(qreal(0), p, qreal(1)) * (values.count() - 1);
+    const int lower = int(position);
+    if (lower + 1 >= values.count())
+        return values.last();
+    return values.at(lower) + (position - lower) * (values.at(lower + 1) - values.at(lower));
+}
+
+// Distribution-free confidence interval for the median: the order statistics
+// around the median whose ranks bound it with the given probability, from the
+// Binomial(n, 1/2) distribution of the number of values below the median. Small
+// samples can not reach the confidence level; their interval is the full range.
+QPair<qreal, qreal> medianConfidenceInterval(QList<qreal> values, qreal confidence)
+{
+    if (values.isEmpty())
+        return qMakePair(qreal(0), qreal(0));
+    qSort(values);
+
+    const int n = values.count();
+    const qreal alpha = (1 - confidence) / 2;
+    qreal cumulative = 0;
+    int lower = 0;
+    for (int i = 0; i < n / 2; ++i) {
+        cumulative += exp(lgamma(n + 1.0) - lgamma(i + 1.0) - lgamma(n - i + 1.0) - n * log(2.0));
+        if (cumulative > alpha)
+            break;
+        lower = i;
+    }
+    return qMakePair(values.at(lower), values.at(n - 1 - lower));
+}
+
+// Whether larger values of \a metric are better: rates and instructions per cycle.
+// For everything else, such as times and event counts, smaller is better.
+bool higherIsBetter(const QString &metric)
+{
+    return metric.endsWith("PerSecond") || metric == "InstructionsPerCycle";
+}
+
+// Student's t distribution
+
+// Continued fraction for the regularized incomplete beta function, see
+// Numerical Recipes in C, 2nd ed., section 6.4.
+static qreal betaContinuedFraction(qreal a, qreal b, qreal x)
+{
+    const int maxIterations = 200;
+    const qreal epsilon = 3e-12;
+    const qreal tiny = 1e-300;
+
+    const qreal qab = a + b;
+    const qreal qap = a + 1;
+    const qreal qam = a - 1;
+    qreal c = 1;
+    qreal d = 1 - qab * x / qap;
+    if (qAbs(d) < tiny)
+        d = tiny;
+    d = 1 / d;
+    qreal h = d;
+    for (int m = 1; m <= maxIterations; ++m) {
+        const int m2 = 2 * m;
+        qreal aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1 + aa * d;
+        if (qAbs(d) < tiny)
+            d = tiny;
+        c = 1 + aa / c;
+        if (qAbs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1 + aa * d;
+        if (qAbs(d) < tiny)
+            d = tiny;
+        c = 1 + aa / c;
+        if (qAbs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        const qreal delta = d * c;
+        h *= delta;
+        if (qAbs(delta - 1) < epsilon)
+            break;
+    }
+    return h;
+}
+
+static qreal incompleteBeta(qreal a, qreal b, qreal x)
+{
+    if (x <= 0)
+        return 0;
+    if (x >= 1)
+        return 1;
+    const qreal front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x));
+    if (x < (a + 1) / (a + b + 2))
+        return front * betaContinuedFraction(a, b, x) / a;
+    return 1 - front * betaContinuedFraction(b, a, 1 - x) / b;
+}
+
+// Returns P(T <= t) for a t distributed variable T.
+qreal studentTDistribution(qreal t, int degreesOfFreedom)
+{
+    const qreal v = degreesOfFreedom;
+    const qreal tail = 0.5 * incompleteBeta(v / 2, 0.5, v / (v + t * t));
+    return t > 0 ? 1 - tail : tail;
+}
+
+// Returns t such that P(T <= t) = p, found by bisection.
+qreal studentTQuantile(qreal p, int degreesOfFreedom)
+{
+    if (degreesOfFreedom < 1 || p <= 0 || p >= 1)
+        return 0;
+    if (p < 0.5)
+        return -studentTQuantile(1 - p, degreesOfFreedom);
+
+    qreal low = 0;
+    qreal high = 1;
+    while (studentTDistribution(high, degreesOfFreedom) < p && high < 1e6)
+        high *= 2;
+    for (int i = 0; i < 100 && high - low > 1e-9; ++i) {
+        const qreal mid = (low + high) / 2;
+        if (studentTDistribution(mid, degreesOfFreedom) < p)
+            low = mid;
+        else
+            high = mid;
+    }
+    return (low + high) / 2;
+}
+
+// Returns the two-sided p-value of Welch's t-test for a difference between the
+// means of \a a and \a b, i.e. the probability of a difference at least this
+// large if the means were equal.
+qreal welchTTest(const QList<qreal> &a, const QList<qreal> &b)
+{
+    if (a.count() < 2 || b.count() < 2)
+        return 1;
+    const qreal meanDifference = mean(b) - mean(a);
+    const qreal va = standardDeviation(a) * standardDeviation(a) / a.count();
+    const qreal vb = standardDeviation(b) * standardDeviation(b) / b.count();
+    if (va + vb == 0)
+        return meanDifference == 0 ? 1 : 0;
+
+    const qreal t = meanDifference / sqrt(va + vb);
+    const qreal degreesOfFreedom =
+        (va + vb) * (va + vb) / (va * va / (a.count() - 1) + vb * vb / (b.count() - 1));
+    const int df = qMax(1, qRound(degreesOfFreedom));
+    return 2 * (1 - studentTDistribution(qAbs(t), df));
+}
+
+// Returns the two-sided p-value of a paired t-test, i.e. of a one sample t-test of
+// the differences b[i] - a[i] against zero. Both lists must be in pair order;
+// unpaired values at the end of the longer one are ignored.
+qreal pairedTTest(const QList<qreal> &a, const QList<qreal> &b)
+{
+    QList<qreal> differences;
+    for (int i = 0; i < qMin(a.count(), b.count()); ++i)
+        differences += b.at(i) - a.at(i);
+    if (differences.count() < 2)
+        return 1;
+    const qreal meanDifference = mean(differences);
+    const qreal standardError = standardDeviation(differences) / sqrt(qreal(differences.count()));
+    if (standardError == 0)
+        return meanDifference == 0 ? 1 : 0;
+    const qreal t = meanDifference / standardError;
+    return 2 * (1 - studentTDistribution(qAbs(t), differences.count() - 1));
+}
+
+// Summary statistics
+
+GeometricMean geometricMean(const QList<qreal> &ratios, qreal confidence)
+{
+    QList<qreal> logs;
+    foreach (qreal ratio, ratios) {
+        if (ratio > 0 && qIsFinite(ratio))
+            logs += log(ratio);
+    }
+
+    GeometricMean result;
+    result.count = logs.count();
+    if (logs.isEmpty())
+        return result;
+
+    const qreal logMean = mean(logs);
+    result.value = exp(logMean);
+    result.lower = result.value;
+    result.upper = result.value;
+    if (logs.count() > 1) {
+        const int degreesOfFreedom = logs.count() - 1;
+        const qreal t = studentTQuantile(1 - (1 - confidence) / 2, degreesOfFreedom);
+        const qreal halfWidth = t * standardDeviation(logs) / sqrt(qreal(logs.count()));
+        result.lower = exp(logMean - halfWidth);
+        result.upper = exp(logMean + halfWidth);
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <QtCore>
+
+qreal mean(const QList<qreal> &values);
+qreal median(QList<qreal> values);
+qreal standardDeviation(const QList<qreal> &values);
+qreal minimum(const QList<qreal> &values);
+qreal medianAbsoluteDeviation(const QList<qreal> &values);
+qreal percentile(QList<qreal> values, qreal p);
+QPair<qreal, qreal> medianConfidenceInterval(QList<qreal> values, qreal confidence = 0.95);
+
+bool higherIsBetter(const QString &metric);
+
+qreal studentTDistribution(qreal t, int degreesOfFreedom);
+qreal studentTQuantile(qreal p, int degreesOfFreedom);
+qreal welchTTest(const QList<qreal> &a, const QList<qreal> &b);
+qreal pairedTTest(const QList<qreal> &a, const QList<qreal> &b);
+
+// Geometric mean of a set of ratios with a confidence interval computed on the
+// log scale. Non-positive ratios can not be part of a geometric mean and are
+// left out; count is the number of ratios actually used.
+struct GeometricMean
+{
+    GeometricMean() : value(0), lower(0), upper(0), count(0) { }
+    qreal value;
+    qreal lower;
+    qreal upper;
+    int count;
+};
+
+GeometricMean geometricMean(const QList<qreal> &ratios, qreal confidence = 0.95);
+
+#endif
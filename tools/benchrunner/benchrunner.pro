@@ -0,0 +1,11 @@
+include (../../benchlib.pri)
+QT += sql xml widgets
+
+DEPENDPATH += .
+INCLUDEPATH += .
+TARGET = benchrunner
+# Input
+HEADERS += ../../src/adaptiverun.h ../../src/processrunner.h ../../src/parallelrun.h \
+           ../../src/bisect.h ../../src/interleavedrun.h
+SOURCES += main.cpp ../../src/adaptiverun.cpp ../../src/processrunner.cpp ../../src/parallelrun.cpp \
+           ../../src/bisect.cpp ../../src/interleavedrun.cpp
@@ -0,0 +1,451 @@
+/****************************************************************************
+**
+** Copyright (C) 2008 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Qt Software Information (qt-info@nokia.com)
+**
+** This file is part of the QTestLib project on Trolltech Labs.
+**
+** This file may be used under the terms of the GNU General Public
+** License version 2.0 or 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of
+** this file.  Please review the following information to ensure GNU
+** General Public Licensing requirements will be met:
+** http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+** http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+#include <QtCore>
+#include <database.h>
+#include <buildrun.h>
+#include <adaptiverun.h>
+#include <parallelrun.h>
+#include <bisect.h>
+#include <interleavedrun.h>
+
+/*
+   *** BenchRunner ***
+
+   Builds and runs QTestLib benchmarks and stores their results in a results database,
+   for generatereport and bmcompare to read. The first argument selects the mode:
+
+       build      builds benchmark directories in parallel (see buildTests())
+       run        runs a benchmark once, optionally pinned to cores
+       adaptive   runs a benchmark until its results have converged
+       parallel   runs the test functions of a benchmark in parallel processes, sharded
+                  over -shards workers, or under callgrind with -callgrind
+       bisect     finds the commit in a git range that made a benchmark slower
+       ab         compares two builds of a benchmark by alternating their runs
+
+   Arguments after "--" are passed on to the benchmark executables.
+*/
+
+enum Mode { NoMode, Build, Run, Adaptive, Parallel, Bisect, AB };
+
+struct Options {
+    Mode mode;
+    QString dataBase;
+    QString runLabel;
+    QString qtPath;
+    int timeout;
+    QStringList arguments;
+    QStringList positional;
+    RunOptions runOptions;
+    BuildOptions buildOptions;
+    QString qmakePath;
+    AdaptiveRunOptions adaptiveOptions;
+    ParallelRunOptions parallelOptions;
+    int shards;
+    bool callgrind;
+    QString outputDirectory;
+    BisectOptions bisectOptions;
+    InterleavedRunOptions interleavedOptions;
+    QString runLabelB;
+    Options()
+        : mode(NoMode), timeout(-1), shards(0), callgrind(false) {}
+};
+
+static bool parseMode(const QString &arg, Mode *mode)
+{
+    if (arg == "build")
+        *mode = Build;
+    else if (arg == "run")
+        *mode = Run;
+    else if (arg == "adaptive")
+        *mode = Adaptive;
+    else if (arg == "parallel")
+        *mode = Parallel;
+    else if (arg == "bisect")
+        *mode = Bisect;
+    else if (arg == "ab")
+        *mode = AB;
+    else
+        return false;
+    return true;
+}
+
+static bool parseInt(const QString &value, int minimum, int *result)
+{
+    bool ok;
+    *result = value.toInt(&ok);
+    return ok && *result >= minimum;
+}
+
+static bool parseArguments(Options &options)
+{
+    QStringList args = qApp->arguments();
+    args.removeFirst();
+    if (args.isEmpty() || !parseMode(args.takeFirst(), &options.mode))
+        return false;
+
+    for (int i = 0; i < args.count(); ++i) {
+        const QString arg = args.at(i);
+        const bool hasValue = i + 1 < args.count();
+        if (arg == "--") {
+            options.arguments = args.mid(i + 1);
+            break;
+        } else if (arg == "-database" && hasValue) {
+            options.dataBase = args.at(++i);
+        } else if (arg == "-label" && hasValue) {
+            options.runLabel = args.at(++i);
+        } else if (arg == "-qt" && hasValue) {
+            options.qtPath = args.at(++i);
+        } else if (arg == "-timeout" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.timeout))
+                return false;
+        } else if (arg == "-cpus" && hasValue) {
+            options.runOptions.cpus = parseCpuList(args.at(++i));
+            if (options.runOptions.cpus.isEmpty())
+                return false;
+        } else if (arg == "-fifo" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.runOptions.fifoPriority))
+                return false;
+        } else if (arg == "-nice" && hasValue) {
+            bool ok;
+            options.runOptions.niceLevel = args.at(++i).toInt(&ok);
+            if (!ok)
+                return false;
+        } else if (arg == "-isolate") {
+            options.runOptions.isolateRunner = true;
+        } else if (arg == "-preflight" && hasValue) {
+            const QString policy = args.at(++i);
+            if (policy == "ignore")
+                options.runOptions.preflight = IgnoreNoisyEnvironment;
+            else if (policy == "warn")
+                options.runOptions.preflight = WarnOnNoisyEnvironment;
+            else if (policy == "refuse")
+                options.runOptions.preflight = RefuseNoisyEnvironment;
+            else
+                return false;
+        } else if (arg == "-nousage") {
+            options.runOptions.measureUsage = false;
+        } else if (arg == "-noperf") {
+            options.runOptions.perfCounters = false;
+        } else if (arg == "-qmake" && hasValue) {
+            options.qmakePath = args.at(++i);
+        } else if (arg == "-j" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.buildOptions.jobs))
+                return false;
+        } else if (arg == "-log" && hasValue) {
+            options.buildOptions.logDirectory = args.at(++i);
+        } else if (arg == "-keepgoing") {
+            options.buildOptions.failFast = false;
+        } else if (arg == "-incremental") {
+            options.buildOptions.incremental = true;
+        } else if (arg == "-ccache" && hasValue) {
+            options.buildOptions.compilerCache = args.at(++i);
+        } else if (arg == "-width" && hasValue) {
+            bool ok;
+            options.adaptiveOptions.targetWidth = args.at(++i).toDouble(&ok) / 100;
+            if (!ok || options.adaptiveOptions.targetWidth <= 0)
+                return false;
+        } else if (arg == "-confidence" && hasValue) {
+            bool ok;
+            const qreal confidence = args.at(++i).toDouble(&ok);
+            if (!ok || confidence <= 0 || confidence >= 1)
+                return false;
+            options.adaptiveOptions.confidence = confidence;
+            options.interleavedOptions.confidence = confidence;
+        } else if (arg == "-min" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.adaptiveOptions.minimumRepetitions))
+                return false;
+        } else if (arg == "-max" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.adaptiveOptions.maximumRepetitions))
+                return false;
+        } else if (arg == "-budget" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.adaptiveOptions.timeBudget))
+                return false;
+        } else if (arg == "-whole") {
+            options.adaptiveOptions.perFunction = false;
+            options.interleavedOptions.perFunction = false;
+        } else if (arg == "-concurrency" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.parallelOptions.concurrency))
+                return false;
+        } else if (arg == "-shards" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.shards))
+                return false;
+        } else if (arg == "-callgrind") {
+            options.callgrind = true;
+        } else if (arg == "-o" && hasValue) {
+            options.outputDirectory = args.at(++i);
+        } else if (arg == "-repository" && hasValue) {
+            options.bisectOptions.repository = args.at(++i);
+        } else if (arg == "-range" && hasValue) {
+            options.bisectOptions.range = args.at(++i);
+        } else if (arg == "-worktree" && hasValue) {
+            options.bisectOptions.worktree = args.at(++i);
+        } else if (arg == "-testcase" && hasValue) {
+            options.bisectOptions.testCase = args.at(++i);
+        } else if (arg == "-function" && hasValue) {
+            options.bisectOptions.function = args.at(++i);
+        } else if (arg == "-tag" && hasValue) {
+            options.bisectOptions.tag = args.at(++i);
+        } else if (arg == "-metric" && hasValue) {
+            options.bisectOptions.metric = args.at(++i);
+        } else if (arg == "-threshold" && hasValue) {
+            bool ok;
+            options.bisectOptions.threshold = args.at(++i).toDouble(&ok);
+            if (!ok || options.bisectOptions.threshold <= 0)
+                return false;
+        } else if (arg == "-repetitions" && hasValue) {
+            if (!parseInt(args.at(++i), 1, &options.bisectOptions.repetitions))
+                return false;
+        } else if (arg == "-rounds" && hasValue) {
+            if (!parseInt(args.at(++i), 2, &options.interleavedOptions.rounds))
+                return false;
+        } else if (arg == "-labelb" && hasValue) {
+            options.runLabelB = args.at(++i);
+        } else if (arg.startsWith("-")) {
+            return false;
+        } else {
+            options.positional += arg;
+        }
+    }
+
+    switch (options.mode) {
+    case Build:
+        return !options.qmakePath.isEmpty() && !options.positional.isEmpty();
+    case Run:
+        return options.positional.count() == 2;
+    case Adaptive:
+        return !options.dataBase.isEmpty() && options.positional.count() == 2;
+    case Parallel:
+        return !(options.dataBase.isEmpty() && options.outputDirectory.isEmpty()) && !options.positional.isEmpty()
+            && (options.callgrind || options.positional.count() == 1);
+    case Bisect:
+        return !options.dataBase.isEmpty() && !options.qmakePath.isEmpty() && !options.bisectOptions.repository.isEmpty()
+            && !options.bisectOptions.range.isEmpty() && !options.bisectOptions.function.isEmpty()
+            && options.positional.count() == 2;
+    case AB:
+        return options.positional.count() == 4 && (options.dataBase.isEmpty() || options.runLabelB.isEmpty() == false);
+    default:
+        return false;
+    }
+}
+
+static void printUsage()
+{
+    const QByteArray name = QFileInfo(qApp->arguments().first()).fileName().toLocal8Bit();
+    const char *runOptions = "[-cpus <list>] [-fifo <priority>] [-nice <level>] [-isolate] "
+                             "[-preflight ignore|warn|refuse] [-nousage] [-noperf]";
+    qDebug() << "usage:" << name.data() << "build -qmake <qmake> [-j <jobs>] [-log <dir>] [-keepgoing] "
+                "[-incremental] [-ccache <wrapper>] <dir 1> [<dir 2> ...]";
+    qDebug() << "      " << name.data() << "run [-database <file> [-label <label>]] [-qt <dir>] [-timeout <ms>]"
+             << runOptions << "<workdir> <executable> [-- <arguments>]";
+    qDebug() << "      " << name.data() << "adaptive -database <file> [-label <label>] [-width <percent>] "
+                "[-confidence <0..1>] [-min <N>] [-max <N>] [-budget <ms>] [-whole]"
+             << runOptions << "<workdir> <executable> [-- <arguments>]";
+    qDebug() << "      " << name.data() << "parallel {-database <file> [-label <label>] | -o <dir>} "
+                "[-concurrency <N>] [-timeout <ms>] {[-shards <N>] <executable> | "
+                "-callgrind <executable 1> [<executable 2> ...]}"
+             << runOptions << "[-- <arguments>]";
+    qDebug() << "      " << name.data() << "bisect -database <file> [-label <session>] -qmake <qmake> "
+                "-repository <dir> -range <good>..<bad> [-worktree <dir>] [-testcase <name>] "
+                "-function <name> [-tag <tag>] [-metric <metric>] [-threshold <percent>] "
+                "[-repetitions <N>] [-j <jobs>] [-ccache <wrapper>]"
+             << runOptions << "<benchmark dir> <executable>";
+    qDebug() << "      " << name.data() << "ab [-database <file> -label <label A> -labelb <label B>] "
+                "[-rounds <N>] [-confidence <0..1>] [-whole]"
+             << runOptions << "<workdir A> <executable A> <workdir B> <executable B> [-- <arguments>]";
+}
+
+static int reportStatus(RunStatus status)
+{
+    if (status.output.isEmpty() == false)
+        qDebug() << status.output.constData();
+    return status.ok() ? 0 : 1;
+}
+
+static int build(const Options &options)
+{
+    const QHash<QString, RunStatus> statuses = buildTests(options.positional, options.qmakePath, options.buildOptions);
+    int failed = 0;
+    foreach (const QString &path, options.positional) {
+        RunStatus status = statuses.value(path);
+        if (status.ok())
+            continue;
+        ++failed;
+        qDebug() << "FAIL:" << path << (status.error == RunStatus::CancelledError ? "(not built)" : "");
+    }
+    qDebug() << "Built" << options.positional.count() - failed << "of" << options.positional.count() << "directories";
+    return failed == 0 ? 0 : 1;
+}
+
+// Runs the benchmark with its output forwarded, or loaded into the database when
+// one is given. The scheduling it ran with is printed.
+static int run(const Options &options)
+{
+    RunStatus status;
+    if (options.dataBase.isEmpty()) {
+        status = runBenchmark(options.qtPath, options.positional.at(0), options.positional.at(1),
+                              options.runOptions, options.timeout, options.arguments);
+    } else {
+        status = runBenchmarkIntoDataBase(options.qtPath, options.positional.at(0), options.positional.at(1),
+                                          options.runOptions, options.runLabel, options.timeout, options.arguments);
+    }
+    QStringList names = status.properties.keys();
+    names.sort();
+    foreach (const QString &name, names)
+        qDebug() << name << status.properties.value(name);
+    return reportStatus(status);
+}
+
+static int adaptive(const Options &options)
+{
+    AdaptiveRunOptions adaptiveOptions = options.adaptiveOptions;
+    adaptiveOptions.arguments = options.arguments;
+    adaptiveOptions.runOptions = options.runOptions;
+    return reportStatus(runBenchmarkAdaptive(options.positional.at(0), options.positional.at(1),
+                                             adaptiveOptions, options.runLabel));
+}
+
+static int parallel(const Options &options)
+{
+    ParallelRunOptions parallelOptions = options.parallelOptions;
+    parallelOptions.arguments = options.arguments;
+    parallelOptions.timeout = options.timeout;
+    parallelOptions.runOptions = options.runOptions;
+
+    ParallelRunResult result;
+    if (options.callgrind) {
+        QList<BenchmarkJob> jobs;
+        foreach (const QString &executable, options.positional)
+            jobs += functionJobs(QFileInfo(executable).absoluteFilePath());
+        parallelOptions.arguments.prepend("-callgrind");
+        result = runBenchmarksParallel(jobs, parallelOptions);
+    } else {
+        const int shards = options.shards > 0 ? options.shards : parallelOptions.concurrency;
+        result = runBenchmarkSharded(QFileInfo(options.positional.first()).absoluteFilePath(), shards, parallelOptions);
+    }
+
+    foreach (RunStatus status, result.statuses) {
+        if (status.ok() == false)
+            reportStatus(status);
+    }
+
+    if (options.outputDirectory.isEmpty() == false) {
+        QDir().mkpath(options.outputDirectory);
+        QMap<QString, QByteArray>::const_iterator it;
+        for (it = result.results.constBegin(); it != result.results.constEnd(); ++it) {
+            QFile file(options.outputDirectory + "/" + it.key() + ".xml");
+            if (file.open(QIODevice::WriteOnly) == false) {
+                qDebug() << "could not write" << file.fileName();
+                return 1;
+            }
+            file.write(it.value());
+        }
+    }
+    if (options.dataBase.isEmpty() == false)
+        loadResults(result, options.runLabel);
+
+    qDebug() << "Ran" << result.statuses.count() << "processes for" << result.results.count() << "test cases";
+    return result.ok() ? 0 : 1;
+}
+
+static int bisect(const Options &options)
+{
+    BisectOptions bisectOptions = options.bisectOptions;
+    bisectOptions.benchmarkPath = options.positional.at(0);
+    bisectOptions.executable = options.positional.at(1);
+    bisectOptions.qmakePath = options.qmakePath;
+    bisectOptions.buildOptions.jobs = options.buildOptions.jobs;
+    bisectOptions.buildOptions.logDirectory = options.buildOptions.logDirectory;
+    bisectOptions.buildOptions.compilerCache = options.buildOptions.compilerCache;
+    bisectOptions.runOptions = options.runOptions;
+    if (options.runLabel.isEmpty() == false)
+        bisectOptions.runLabel = options.runLabel;
+
+    const BisectResult result = bisectRegression(bisectOptions);
+    QMap<QString, qreal>::const_iterator it;
+    for (it = result.values.constBegin(); it != result.values.constEnd(); ++it)
+        qDebug() << it.key() << it.value();
+    if (result.error.isEmpty() == false) {
+        qDebug() << "bisect failed:" << result.error;
+        return 1;
+    }
+    if (result.found())
+        qDebug() << "First regressed commit:" << result.firstBadCommit;
+    else
+        qDebug() << "No regression found in" << bisectOptions.range;
+    qDebug() << "Results are stored under" << result.runLabel + "/<commit>";
+    return 0;
+}
+
+static int ab(const Options &options)
+{
+    InterleavedBenchmark a;
+    a.workdir = options.positional.at(0);
+    a.executable = options.positional.at(1);
+    InterleavedBenchmark b;
+    b.workdir = options.positional.at(2);
+    b.executable = options.positional.at(3);
+    if (options.dataBase.isEmpty() == false) {
+        a.runLabel = options.runLabel;
+        b.runLabel = options.runLabelB;
+    }
+
+    InterleavedRunOptions interleavedOptions = options.interleavedOptions;
+    interleavedOptions.arguments = options.arguments;
+    interleavedOptions.runOptions = options.runOptions;
+    return reportStatus(runBenchmarksInterleaved(a, b, interleavedOptions).status);
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    Options options;
+    if (!parseArguments(options)) {
+        printUsage();
+        return 1;
+    }
+
+    if (options.dataBase.isEmpty() == false) {
+        openResultsDataBase(options.dataBase);
+        // A bisect session is labelled by bisectRegression() unless -label is given.
+        if (options.runLabel.isEmpty() && options.mode != Bisect)
+            options.runLabel = QDateTime::currentDateTime().toString(Qt::ISODate);
+    }
+
+    switch (options.mode) {
+    case Build:
+        return build(options);
+    case Run:
+        return run(options);
+    case Adaptive:
+        return adaptive(options);
+    case Parallel:
+        return parallel(options);
+    case Bisect:
+        return bisect(options);
+    case AB:
+        return ab(options);
+    default:
+        return 1;
+    }
+}
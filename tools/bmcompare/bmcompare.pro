@@ -4,5 +4,6 @@ INCLUDEPATH += .
 TARGET = bmcompare
 # Input
 SOURCES += main.cpp
-QT += xml
+QT += sql xml widgets concurrent
 CONFIG += console
+include (../../benchlib.pri)
@@ -44,6 +44,18 @@
    while each -cmp option specifies that the following file names belong to the next set of
    comparable results.
 
+   Instead of XML files, the reference may be read from a results database written by
+   generatereport (see its -database and -label options):
+
+             ./bmcompare -refdb results.db [-refversion <Qt version> | -reflabel <run label> |
+                                            -reflast <N>] -cmp cmp1.xml ...
+
+   -refversion and -reflabel select the runs with the given Qt version or run label, while
+   -reflast selects the N most recently added runs (the default is the last run). When the
+   selection spans several runs, each run contributes one sample (see below), so with the
+   default estimator the reference is the median over those runs, which makes for a more
+   robust baseline than any single run.
+
    The output is dumped to stdout as a table like this:
 
        <function>        <tag>
@@ -61,12 +73,15 @@
     macro. The tag is the data tag that identifies a row of input data
     specified by the corresponding _data function (i.e. matching the argument
     to QTest::newRow()). The tag will be an empty string in the absence of a
-    _data function. If several identical function/tag combinations are
-    detected, only the first one is used.
+    _data function.
 
     The rows in a group indicate results for each unique metric found for this
-    function/tag combination. If several identical metrics are found for the
-    combination, only the first one is used.
+    function/tag combination. If the same function/tag/metric combination is found
+    several times within a set of results (typically because the benchmarks were run
+    repeatedly to beat noise), every occurrence is kept as a sample, and the samples are
+    reduced to a single value before comparison by the estimator given with -estimator:
+    median (the default), min, mean or first. Passing -spread appends the median absolute
+    deviation of each compared value, as a percentage of that value, and the sample count.
 
     Horizontally, there is (to the right of the metric name) one column per set of
     comparable results, i.e. one column per occurrence of '-cmp' in the command-line
@@ -77,17 +92,111 @@
     presented as a percentage difference instead (e.g. -5% and 5% mean a 5% decrease and increase
     respectively).
 
+    A value counts as better or worse than the reference when it differs by more than the
+    percentage given with -threshold (default 0). Lower values are better; with -polarity,
+    higher values are better for the "...PerSecond" throughput metrics and
+    InstructionsPerCycle. Rows whose reference value is 0 have no ratios; their values are
+    shown as "(zero ref)" and left out of summaries, standings and sorting.
+
+    By passing -summary on the command line, the table is followed by summary rows that answer
+    whether a set of comparable results is faster overall: for each metric, per test function
+    and for the whole suite, the geometric mean of the ratios to the reference is shown together
+    with its 95% confidence interval and the number of better (+), worse (-) and unchanged (=)
+    rows.
+
+    When several sets of comparable results are evaluated against each other (e.g. allocator
+    or compiler flag variants), passing -matrix ranks the sets in every row: each value is
+    followed by its rank (#1 being the best), and the row ends with the winning set and its
+    margin over the runner-up. The table is then followed by standings per metric, listing
+    for each set the number of rows it won and lost (ranked last), its mean rank and the
+    geometric mean of its ratios to the reference. A set is labelled cmp1, cmp2, ... unless
+    it is given a name with -name <label> after its -cmp option.
+
+    Instead of comparing against a reference, bmcompare can look for the runs at which a
+    benchmark got slower (or faster) in a chronological series of runs:
+
+             ./bmcompare -changepoints -run run1a.xml run1b.xml ... -run run2a.xml ... -run ...
+             ./bmcompare -changepoints -rundb results.db
+
+    Each -run option starts the files of the next run; with -rundb, every run stored in the
+    results database is used, in the order the runs were added. Every function/tag/metric
+    series (one estimated value per run) is scanned for step changes with PELT, the series
+    being analyzed in parallel. For each change point, the index and name of the first run
+    after the step, the medians before and after it, the size of the step (as for the
+    comparison table, see -diff) and the confidence that the step is real (one minus the
+    p-value of a t-test between the two segments) are printed. Only change points with a
+    confidence of at least -confidence <0..1> (default 0.95) are shown; -penalty <factor>
+    (default 2) makes detection more (lower) or less (higher) sensitive.
+
+    The rows can be narrowed down with -function, -tag and -metric, each taking a regular
+    expression that must match somewhere in the function name, data tag or metric name. With
+    -sort, rows are listed by decreasing size of change instead of in output order:
+    "delta" sorts by the absolute percentage difference, "ratio" by the ratio to the
+    reference (regressions first) and "significance" by the confidence that the difference
+    is real (Welch's t-test between the samples, so this needs repeated runs). A row is
+    sorted by the set of comparable results that is furthest from the reference. -top <N>
+    keeps only the first N rows. Filtering, sorting and cutting happen before any output
+    is formatted; summaries and standings cover all rows that pass the filters.
+
+    A fixed -threshold does not fit benchmarks with very different noise levels. With
+    -noisedb <database>, a noise model is computed for every function/tag/metric from the
+    history in a results database (which may be the -refdb database): the coefficient of
+    variation, the median absolute deviation and the distribution of changes between
+    consecutive runs. A row then only counts as better or worse when its change exceeds that
+    benchmark's own noise floor (or -threshold, if larger), and the noise floor is shown
+    after the row. Benchmarks with fewer than three runs of history fall back to
+    -threshold. Benchmarks whose robust coefficient of variation exceeds the -quarantine
+    percentage (default 10) are flagged as quarantined; their results should not be trusted.
+
+    With -html <file>, the comparison is also written as an HTML report built from the same
+    templates as generatereport's reports. It holds a table of all rows that can be sorted
+    by clicking a column header, a bar chart per test function of each set's ratio to the
+    reference and, for data tags of the form "<series>--<index>", line charts overlaying
+    the reference and comparable values of each series over the index.
+
+    A -cmp option may also name a directory, which stands for the *.xml files in it (in
+    file name order). With -watch, bmcompare keeps running after printing the comparison and
+    watches the -cmp files and directories. Whenever files are added, modified or removed,
+    only those files are parsed again and the comparison (and the -html report) is redone;
+    the reference and the unchanged files stay parsed in memory. Changes are collected for
+    half a second before updating, so a file that is still being written is not picked up
+    half way.
+
+    XML files are parsed concurrently on a thread pool, one file per task, and the per-file
+    results are merged in command-line order afterwards.
+
     The output is colored using ANSI escape codes iff the QTEST_COLORED environment variable
     is set.
  */
 
 #include <QtCore>
 #include <QtXml>
+#include <QtSql>
+#include <database.h>
+#include <statistics.h>
+#include <changepoint.h>
+#include <noisemodel.h>
+#include <reportgenerator.h>
+#include <QtConcurrent>
+
+enum Estimator { Median, Minimum, Mean, First };
 
 struct MetricResult {
-    int value;
-    int iterations;
-    MetricResult(int value, int iterations) : value(value), iterations(iterations) {}
+    QList<qreal> samples; // per iteration values, in the order they were found
+
+    qreal estimate(Estimator estimator) const {
+        Q_ASSERT(!samples.isEmpty());
+        switch (estimator) {
+        case Minimum:
+            return minimum(samples);
+        case Mean:
+            return mean(samples);
+        case First:
+            return samples.first();
+        default:
+            return median(samples);
+        }
+    }
 };
 
 typedef QMap<QString, MetricResult *> MetricResults;
@@ -109,8 +218,12 @@ struct BenchmarkResult {
 
 typedef QMap<QString, BenchmarkResult *> BenchmarkResults;
 
-static void mergeBenchmarkResults(const QString &xmlFile, BenchmarkResults *bmResults)
+// Parses one XML file into a new set of results. Files are parsed concurrently, so this
+// must not touch any shared state.
+static BenchmarkResults *parseBenchmarkResults(const QString &xmlFile)
 {
+    BenchmarkResults *bmResults = new BenchmarkResults;
+
     QFile f(xmlFile);
     f.open(QIODevice::ReadOnly);
     QByteArray xml = f.readAll();
@@ -139,8 +252,8 @@ static void mergeBenchmarkResults(const QString &xmlFile, BenchmarkResults *bmRe
             
             QString valueString = result.attributeNode("value").value();
             QString iterationsString = result.attributeNode("iterations").value();
-            const int value = valueString.toInt();
-            const int iterations = iterationsString.toInt();
+            const qreal value = valueString.toDouble();
+            const int iterations = qMax(iterationsString.toInt(), 1);
 
             const QString funcTag = functionName + tag;
             BenchmarkResult *bmResult = bmResults->value(funcTag);
@@ -151,16 +264,274 @@ static void mergeBenchmarkResults(const QString &xmlFile, BenchmarkResults *bmRe
 
             MetricResult *metricResult = bmResult->metricResults.value(metric);
             if (!metricResult) {
-                metricResult = new MetricResult(value, iterations);
+                metricResult = new MetricResult;
                 bmResult->metricResults.insert(metric, metricResult);
             }
+            metricResult->samples += value / iterations;
+        }
+    }
+
+    return bmResults;
+}
+
+// Moves the results of \a partialResults into \a bmResults, adding the samples of
+// function/tag/metric combinations found in both. \a partialResults is deleted.
+static void mergeBenchmarkResults(BenchmarkResults *partialResults, BenchmarkResults *bmResults)
+{
+    QList<BenchmarkResult *> sortedPartialResults(partialResults->values());
+    qSort(sortedPartialResults.begin(), sortedPartialResults.end(), BenchmarkResult::LessThan());
+
+    foreach (BenchmarkResult *partialResult, sortedPartialResults) {
+        const QString funcTag = partialResult->function + partialResult->tag;
+        BenchmarkResult *bmResult = bmResults->value(funcTag);
+        if (!bmResult) {
+            partialResult->outputPos = bmResults->count();
+            bmResults->insert(funcTag, partialResult);
+            continue;
+        }
+
+        foreach (QString metric, partialResult->metricResults.keys()) {
+            MetricResult *partialMetricResult = partialResult->metricResults.value(metric);
+            MetricResult *metricResult = bmResult->metricResults.value(metric);
+            if (metricResult) {
+                metricResult->samples += partialMetricResult->samples;
+                delete partialMetricResult;
+            } else {
+                bmResult->metricResults.insert(metric, partialMetricResult);
+            }
         }
+        delete partialResult;
     }
+
+    delete partialResults;
 }
 
 typedef QList<BenchmarkResults *> BenchmarkResultsList;
 
-enum ValueMode { Identical, Better, Worse, NotFound };
+// Returns a deep copy of \a bmResults.
+static BenchmarkResults *copyBenchmarkResults(const BenchmarkResults *bmResults)
+{
+    BenchmarkResults *copy = new BenchmarkResults;
+    for (BenchmarkResults::const_iterator it = bmResults->constBegin(); it != bmResults->constEnd(); ++it) {
+        const BenchmarkResult *bmResult = it.value();
+        BenchmarkResult *resultCopy = new BenchmarkResult(bmResult->function, bmResult->tag, bmResult->outputPos);
+        foreach (QString metric, bmResult->metricResults.keys())
+            resultCopy->metricResults.insert(metric, new MetricResult(*bmResult->metricResults.value(metric)));
+        copy->insert(it.key(), resultCopy);
+    }
+    return copy;
+}
+
+static void deleteBenchmarkResults(BenchmarkResults *bmResults)
+{
+    foreach (BenchmarkResult *bmResult, *bmResults) {
+        qDeleteAll(bmResult->metricResults);
+        delete bmResult;
+    }
+    delete bmResults;
+}
+
+// Returns the files of \a paths, with each directory replaced by the *.xml files in it.
+static QStringList resultFiles(const QStringList &paths)
+{
+    QStringList files;
+    foreach (QString path, paths) {
+        if (!QFileInfo(path).isDir()) {
+            files += path;
+            continue;
+        }
+        QDir dir(path);
+        foreach (QString name, dir.entryList(QStringList() << "*.xml", QDir::Files, QDir::Name))
+            files += dir.filePath(name);
+    }
+    return files;
+}
+
+// Parses the files of all \a fileSets on the global thread pool, then merges the
+// per-file results of each set in file order, so the output order does not depend
+// on which file finished parsing first.
+static BenchmarkResultsList parseBenchmarkResultSets(const QList<QStringList> &fileSets)
+{
+    QStringList allFiles;
+    foreach (QStringList files, fileSets)
+        allFiles += files;
+
+    const QList<BenchmarkResults *> partialResultsList =
+        QtConcurrent::blockingMapped(allFiles, parseBenchmarkResults);
+
+    BenchmarkResultsList resultsList;
+    int partial = 0;
+    foreach (QStringList files, fileSets) {
+        BenchmarkResults *bmResults = new BenchmarkResults;
+        for (int i = 0; i < files.count(); ++i)
+            mergeBenchmarkResults(partialResultsList.at(partial++), bmResults);
+        resultsList << bmResults;
+    }
+    return resultsList;
+}
+
+struct RefSelection {
+    QString dataBase;
+    QString version;
+    QString label;
+    int lastRuns;
+    RefSelection() : lastRuns(0) {}
+};
+
+// Returns the labels of the \a count runs most recently added to the Results table.
+static QStringList lastRunLabels(int count)
+{
+    QSqlQuery query;
+    query.prepare("SELECT RunLabel FROM Results GROUP BY RunLabel ORDER BY MAX(rowid) DESC LIMIT :count");
+    query.bindValue(":count", count);
+    execQuery(query);
+
+    QStringList labels;
+    while (query.next())
+        labels += query.value(0).toString();
+    return labels;
+}
+
+// Returns the labels of all runs in the Results table, in the order they were added.
+static QStringList allRunLabels()
+{
+    QSqlQuery query;
+    query.prepare("SELECT RunLabel FROM Results GROUP BY RunLabel ORDER BY MIN(rowid)");
+    execQuery(query);
+
+    QStringList labels;
+    while (query.next()) {
+        if (!query.value(0).toString().isEmpty())
+            labels += query.value(0).toString();
+    }
+    return labels;
+}
+
+// Adds the results selected by \a selection from the open results database to \a bmResults.
+// The stored results are per iteration already; if the selection matches several runs,
+// each run contributes one sample.
+static void mergeDataBaseResults(const RefSelection &selection, BenchmarkResults *bmResults)
+{
+    QString where;
+    QStringList bindings;
+    if (!selection.version.isEmpty()) {
+        where = " WHERE QtVersion = ?";
+        bindings << selection.version;
+    } else if (!selection.label.isEmpty()) {
+        where = " WHERE RunLabel = ?";
+        bindings << selection.label;
+    } else {
+        bindings = lastRunLabels(qMax(selection.lastRuns, 1));
+        QStringList placeholders;
+        for (int i = 0; i < bindings.count(); ++i)
+            placeholders << "?";
+        where = " WHERE RunLabel IN (" + placeholders.join(", ") + ")";
+    }
+
+    QSqlQuery query;
+    query.prepare("SELECT TestCaseName, Series, Idx, Metric, Result FROM Results" + where + " ORDER BY rowid");
+    foreach (const QString &binding, bindings)
+        query.addBindValue(binding);
+    execQuery(query);
+
+    int outputPos = 0;
+    while (query.next()) {
+        const QString functionName = query.value(0).toString();
+        const QString series = query.value(1).toString();
+        const QString index = query.value(2).toString();
+        const QString metric = query.value(3).toString();
+
+        const QString tag = resultTag(series, index);
+
+        const QString funcTag = functionName + tag;
+        BenchmarkResult *bmResult = bmResults->value(funcTag);
+        if (!bmResult) {
+            bmResult = new BenchmarkResult(functionName, tag, outputPos++);
+            bmResults->insert(funcTag, bmResult);
+        }
+        MetricResult *metricResult = bmResult->metricResults.value(metric);
+        if (!metricResult) {
+            metricResult = new MetricResult;
+            bmResult->metricResults.insert(metric, metricResult);
+        }
+        metricResult->samples += query.value(4).toDouble();
+    }
+
+    if (bmResults->isEmpty())
+        qDebug() << "no reference results selected from" << selection.dataBase;
+}
+
+enum ValueMode { Identical, Better, Worse, NotFound, ZeroReference };
+
+// Set by -polarity. Without it, lower values are better for every metric.
+static bool metricPolarity = false;
+
+static bool betterWhenHigher(const QString &metric)
+{
+    return metricPolarity && higherIsBetter(metric);
+}
+
+// Classifies a value given as a percentage of the reference. Deviations of at most
+// \a threshold percent count as identical.
+static ValueMode classify(qreal cmpPercentage, const QString &metric, qreal threshold)
+{
+    if (qAbs(cmpPercentage - 100) <= threshold)
+        return Identical;
+    const bool better = betterWhenHigher(metric) ? cmpPercentage > 100 : cmpPercentage < 100;
+    return better ? Better : Worse;
+}
+
+// Accumulates the comparisons of one set of comparable results against the reference.
+struct Summary {
+    QList<qreal> ratios;
+    int better;
+    int worse;
+    int unchanged;
+    Summary() : better(0), worse(0), unchanged(0) {}
+
+    void add(qreal ratio, ValueMode valueMode) {
+        ratios += ratio;
+        if (valueMode == Better)
+            ++better;
+        else if (valueMode == Worse)
+            ++worse;
+        else
+            ++unchanged;
+    }
+};
+
+typedef QVector<Summary> Summaries; // one per set of comparable results
+typedef QMap<QString, Summaries> MetricSummaries;
+
+// Ranks \a values from best to worst, giving tied values the same rank. Values that
+// were not found get rank 0.
+static QVector<int> rankValues(
+    const QVector<qreal> &values, const QVector<bool> &found, const QString &metric)
+{
+    const bool higher = betterWhenHigher(metric);
+    QVector<int> ranks(values.count(), 0);
+    for (int i = 0; i < values.count(); ++i) {
+        if (!found.at(i))
+            continue;
+        ranks[i] = 1;
+        for (int j = 0; j < values.count(); ++j) {
+            if (found.at(j) && (higher ? values.at(j) > values.at(i) : values.at(j) < values.at(i)))
+                ++ranks[i];
+        }
+    }
+    return ranks;
+}
+
+// Accumulates how one set of comparable results fares against the other sets.
+struct Standing {
+    int wins;
+    int losses;
+    int rankSum;
+    QList<qreal> ratios;
+    Standing() : wins(0), losses(0), rankSum(0) {}
+};
+
+typedef QVector<Standing> Standings; // one per set of comparable results
 
 static QString valueString(qreal value, ValueMode valueMode)
 {
@@ -173,9 +544,9 @@ static QString valueString(qreal value, ValueMode valueMode)
     out.setRealNumberPrecision(fracWidth);
     out.setRealNumberNotation(QTextStream::FixedNotation);
 
-    if (valueMode == NotFound) {
+    if (valueMode == NotFound || valueMode == ZeroReference) {
         out.setFieldWidth(cmpPercentageWidth + symbolWidth);
-        out << "(not found)";
+        out << (valueMode == NotFound ? "(not found)" : "(zero ref)");
     } else {
         out.setFieldWidth(cmpPercentageWidth);
         out << value;
@@ -199,7 +570,7 @@ static QString valueString(qreal value, ValueMode valueMode)
         }
     }
 
-    if (valueMode != NotFound) {
+    if (valueMode != NotFound && valueMode != ZeroReference) {
         QString symbol;
         QTextStream out2(&symbol);
         out2.setFieldWidth(symbolWidth);
@@ -210,39 +581,209 @@ static QString valueString(qreal value, ValueMode valueMode)
     return result;
 }
 
-static void printBenchmarkResults(
-    const QStringList &refFiles, const QList<QStringList> &cmpFilesList, bool diffMode)
+// Returns the median absolute deviation of \a samples as a percentage of \a value,
+// followed by the sample count.
+static QString spreadString(const QList<qreal> &samples, qreal value)
 {
-    BenchmarkResults *refResults = new BenchmarkResults;
-    BenchmarkResultsList cmpResultsList;
+    const qreal spread = value == 0 ? 0 : medianAbsoluteDeviation(samples) / qAbs(value) * 100;
+    return QString(" (+-%1% n=%2)").arg(spread, 0, 'f', 1).arg(samples.count());
+}
 
-    // Merge ...
+// Returns the winner of a ranked row and its margin over the runner-up.
+static QString winnerString(const QVector<qreal> &values, const QVector<int> &ranks,
+                            const QString &metric, const QStringList &labels)
+{
+    int winner = -1;
+    int runnerUp = -1;
+    for (int i = 0; i < ranks.count(); ++i) {
+        if (ranks.at(i) == 1 && winner == -1)
+            winner = i;
+        else if (ranks.at(i) > 0 && (runnerUp == -1 || ranks.at(i) < ranks.at(runnerUp)))
+            runnerUp = i;
+    }
+    if (winner == -1)
+        return QString();
+    if (runnerUp == -1)
+        return "  " + labels.at(winner);
+    if (ranks.at(runnerUp) == 1)
+        return "  (tie)";
+
+    const qreal best = values.at(winner);
+    const qreal next = values.at(runnerUp);
+    const qreal margin = betterWhenHigher(metric) ? (best / next - 1) * 100 : (next / best - 1) * 100;
+    return QString("  %1 by %2%").arg(labels.at(winner)).arg(margin, 0, 'f', 1);
+}
 
-    foreach (QString refFile, refFiles) {
-        mergeBenchmarkResults(refFile, refResults);
+static void printStandings(
+    QTextStream &out, const QMap<QString, Standings> &metricStandings, const QStringList &labels)
+{
+    foreach (QString metric, metricStandings.keys()) {
+        const Standings standings = metricStandings.value(metric);
+
+        // Order the sets by their geometric mean, best first.
+        QList<QPair<qreal, int> > order;
+        for (int i = 0; i < standings.count(); ++i) {
+            const qreal gm = geometricMean(standings.at(i).ratios).value;
+            order += qMakePair(betterWhenHigher(metric) ? -gm : gm, i);
+        }
+        qSort(order);
+
+        out << "\n" << metric << "\n";
+        for (int j = 0; j < order.count(); ++j) {
+            const int i = order.at(j).second;
+            const Standing &standing = standings.at(i);
+            const GeometricMean gm = geometricMean(standing.ratios);
+            const qreal meanRank = standing.ratios.isEmpty() ? 0 : qreal(standing.rankSum) / standing.ratios.count();
+            out << "    ";
+            out.setFieldWidth(12);
+            out.setFieldAlignment(QTextStream::AlignLeft);
+            out << labels.at(i);
+            out.setFieldWidth(0);
+            out << QString("wins %1  losses %2  mean rank %3  geomean %4% [%5, %6]")
+                .arg(standing.wins, 5).arg(standing.losses, 5).arg(meanRank, 5, 'f', 2)
+                .arg(gm.value * 100, 0, 'f', 1).arg(gm.lower * 100, 0, 'f', 1).arg(gm.upper * 100, 0, 'f', 1)
+                << "\n";
+        }
     }
-    foreach (QStringList cmpFiles, cmpFilesList) {
-        BenchmarkResults *cmpResults = new BenchmarkResults;
-        foreach (QString cmpFile, cmpFiles) {
-            mergeBenchmarkResults(cmpFile, cmpResults);
+}
+
+static void printSummaries(
+    QTextStream &out, const MetricSummaries &metricSummaries, bool diffMode, qreal threshold)
+{
+    foreach (QString metric, metricSummaries.keys()) {
+        out << "    ";
+        out.setFieldWidth(9);
+        out.setFieldAlignment(QTextStream::AlignLeft);
+        out << metric;
+        out.setFieldWidth(0);
+        foreach (const Summary &summary, metricSummaries.value(metric)) {
+            const GeometricMean gm = geometricMean(summary.ratios);
+            if (gm.count == 0) {
+                out << valueString(-1, NotFound);
+            } else {
+                const qreal offset = diffMode ? 100 : 0;
+                out << valueString(gm.value * 100 - offset, classify(gm.value * 100, metric, threshold));
+                out << QString(" [%1, %2]")
+                    .arg(gm.lower * 100 - offset, 0, 'f', 1).arg(gm.upper * 100 - offset, 0, 'f', 1);
+            }
+            out << QString(" +%1 -%2 =%3").arg(summary.better).arg(summary.worse).arg(summary.unchanged);
         }
-        cmpResultsList << cmpResults;
+        out << "\n";
     }
+}
 
-    // Print ...
+enum SortOrder { OutputOrder, SortByDelta, SortByRatio, SortBySignificance };
+
+struct Options {
+    QStringList refFiles;
+    RefSelection refSelection;
+    QList<QStringList> cmpFilesList;
+    QMap<int, QString> cmpNames;
+    QList<QStringList> runFilesList;
+    QString runDataBase;
+    QString noiseDataBase;
+    qreal quarantineThreshold;
+    QString htmlFile;
+    QRegExp functionFilter;
+    QRegExp tagFilter;
+    QRegExp metricFilter;
+    SortOrder sortOrder;
+    int top;
+    bool diffMode;
+    bool summary;
+    bool spread;
+    bool matrix;
+    bool changePoints;
+    bool watch;
+    qreal threshold;
+    qreal confidence;
+    qreal penalty;
+    Estimator estimator;
+    Options()
+        : quarantineThreshold(10), sortOrder(OutputOrder), top(0), diffMode(false), summary(false),
+          spread(false), matrix(false), changePoints(false), watch(false), threshold(0), confidence(0.95),
+          penalty(2), estimator(Median) {}
+
+    QStringList cmpLabels() const {
+        QStringList labels;
+        for (int i = 0; i < cmpFilesList.count(); ++i)
+            labels += cmpNames.value(i, QString("cmp%1").arg(i + 1));
+        return labels;
+    }
+};
+
+// One function/tag/metric row of a comparison.
+struct ComparisonRow {
+    BenchmarkResult *refResult;
+    QString metric;
+    MetricResult *refMetricResult;
+    qreal refValue;
+    bool zeroReference; // refValue is 0, so there are no ratios to it
+    QVector<MetricResult *> cmpMetricResults; // 0 where not found
+    QVector<qreal> cmpValues;
+    QVector<int> ranks; // only with -matrix
+    qreal threshold; // -threshold or the noise floor, in percent
+    const NoiseStats *noise; // 0 without a noise model
+    qreal sortKey;
+    qreal secondarySortKey;
+
+    struct GreaterThan {
+        bool operator()(const ComparisonRow &a, const ComparisonRow &b) {
+            if (a.sortKey != b.sortKey)
+                return a.sortKey > b.sortKey;
+            return a.secondarySortKey > b.secondarySortKey;
+        }
+    };
+};
+
+struct Comparison {
+    QList<ComparisonRow> rows;
+    QStringList summaryFunctions;
+    QHash<QString, MetricSummaries> functionSummaries;
+    MetricSummaries suiteSummaries;
+    QMap<QString, Standings> metricStandings;
+};
+
+// Computes the sort keys of \a row from the set of comparable results that is furthest
+// from the reference. Rows without any comparable result sort last.
+static void computeSortKeys(ComparisonRow *row, SortOrder sortOrder)
+{
+    row->sortKey = -1;
+    row->secondarySortKey = -1;
+    if (row->zeroReference)
+        return;
+    for (int i = 0; i < row->cmpValues.count(); ++i) {
+        if (!row->cmpMetricResults.at(i))
+            continue;
+        const qreal ratio = row->cmpValues.at(i) / row->refValue;
+        const qreal delta = qAbs(ratio - 1);
+        qreal key = delta;
+        if (sortOrder == SortByRatio)
+            key = betterWhenHigher(row->metric) ? 1 / ratio : ratio;
+        else if (sortOrder == SortBySignificance)
+            key = 1 - welchTTest(row->refMetricResult->samples, row->cmpMetricResults.at(i)->samples);
+        row->sortKey = qMax(row->sortKey, key);
+        row->secondarySortKey = qMax(row->secondarySortKey, delta);
+    }
+}
+
+// Builds the rows that pass the filters, accumulating summaries and standings on the
+// way, then sorts and cuts them as requested. Nothing is formatted here.
+static Comparison compareBenchmarkResults(
+    const Options &options, BenchmarkResults *refResults, const BenchmarkResultsList &cmpResultsList,
+    const NoiseModel &noiseModel)
+{
+    Comparison comparison;
 
     QList<BenchmarkResult *> sortedRefResults(refResults->values());
     qSort(sortedRefResults.begin(), sortedRefResults.end(), BenchmarkResult::LessThan());
 
-    QTextStream out(stdout);
-
     foreach (BenchmarkResult *refResult, sortedRefResults) {
-        out << "\n";
-        out.setFieldWidth(20);
-        out.setFieldAlignment(QTextStream::AlignLeft);
-        out << (refResult->function + "()");
-        out.setFieldWidth(0);
-        out << refResult->tag << "\n";
+        if (!options.functionFilter.isEmpty() && !refResult->function.contains(options.functionFilter))
+            continue;
+        if (!options.tagFilter.isEmpty() && !refResult->tag.contains(options.tagFilter))
+            continue;
+
         QStringList metrics = refResult->metricResults.keys();
         metrics.sort();
         const QString funcTag = refResult->function + refResult->tag;
@@ -253,105 +794,811 @@ static void printBenchmarkResults(
         }
 
         foreach (QString metric, metrics) {
-            MetricResult *metricResult = refResult->metricResults.value(metric);
-            Q_ASSERT(metricResult->iterations > 0);
-            const qreal refValue = metricResult->value / qreal(metricResult->iterations);
-            out << "    ";
-            out.setFieldWidth(9);
-            out.setFieldAlignment(QTextStream::AlignLeft);
-            out << metric;
-
-            out.setFieldAlignment(QTextStream::AlignRight);
-            foreach (BenchmarkResult *cmpResult, cmpResults) {
-                bool found = false;
-                if (cmpResult) {
-
-                    MetricResult *cmpMetricResult = cmpResult->metricResults.value(metric);
-                    if (cmpMetricResult) {
-                        const qreal cmpValue =
-                            cmpMetricResult->value / qreal(cmpMetricResult->iterations);
-                        qreal cmpPercentage = (cmpValue / refValue) * 100;
-                        ValueMode valueMode = Identical;
-                        if (cmpPercentage < 100)
-                            valueMode = Better;
-                        else if (cmpPercentage > 100)
-                            valueMode = Worse;
-                        if (diffMode)
-                            cmpPercentage = cmpPercentage - 100;
-                        out.setFieldWidth(0);
-                        out << valueString(cmpPercentage, valueMode);
-                        found = true;
-                    }
+            if (!options.metricFilter.isEmpty() && !metric.contains(options.metricFilter))
+                continue;
+
+            ComparisonRow row;
+            row.refResult = refResult;
+            row.metric = metric;
+            row.refMetricResult = refResult->metricResults.value(metric);
+            row.refValue = row.refMetricResult->estimate(options.estimator);
+            row.zeroReference = row.refValue == 0;
+            row.threshold = options.threshold;
+            row.noise = 0;
+            NoiseModel::const_iterator noise =
+                noiseModel.constFind(noiseKey(refResult->function, refResult->tag, metric));
+            if (noise != noiseModel.constEnd() && noise->isValid()) {
+                row.noise = &noise.value();
+                row.threshold = qMax(options.threshold, row.noise->noiseFloor() * 100);
+            }
+
+            Summaries *functionSummary = 0;
+            Summaries *suiteSummary = 0;
+            if (options.summary) {
+                if (!comparison.functionSummaries.contains(refResult->function))
+                    comparison.summaryFunctions += refResult->function;
+                functionSummary = &comparison.functionSummaries[refResult->function][metric];
+                suiteSummary = &comparison.suiteSummaries[metric];
+                functionSummary->resize(cmpResults.count());
+                suiteSummary->resize(cmpResults.count());
+            }
+
+            row.cmpMetricResults = QVector<MetricResult *>(cmpResults.count(), 0);
+            row.cmpValues = QVector<qreal>(cmpResults.count(), 0);
+            QVector<bool> cmpFound(cmpResults.count(), false);
+            for (int i = 0; i < cmpResults.count(); ++i) {
+                if (cmpResults.at(i))
+                    row.cmpMetricResults[i] = cmpResults.at(i)->metricResults.value(metric);
+                if (!row.cmpMetricResults.at(i))
+                    continue;
+                row.cmpValues[i] = row.cmpMetricResults.at(i)->estimate(options.estimator);
+                cmpFound[i] = true;
+                if (options.summary && !row.zeroReference) {
+                    const qreal ratio = row.cmpValues.at(i) / row.refValue;
+                    const ValueMode valueMode = classify(ratio * 100, metric, row.threshold);
+                    (*functionSummary)[i].add(ratio, valueMode);
+                    (*suiteSummary)[i].add(ratio, valueMode);
                 }
-                if (!found) {
-                    out.setFieldWidth(0);
-                    out << valueString(-1, NotFound);;
+            }
+
+            if (options.matrix) {
+                row.ranks = rankValues(row.cmpValues, cmpFound, metric);
+                Standings &standings = comparison.metricStandings[metric];
+                standings.resize(cmpResults.count());
+                int worstRank = 0;
+                foreach (int rank, row.ranks)
+                    worstRank = qMax(worstRank, rank);
+                for (int i = 0; i < row.ranks.count(); ++i) {
+                    if (row.ranks.at(i) == 0)
+                        continue;
+                    if (!row.zeroReference)
+                        standings[i].ratios += row.cmpValues.at(i) / row.refValue;
+                    standings[i].rankSum += row.ranks.at(i);
+                    if (row.ranks.at(i) == 1 && worstRank > 1)
+                        ++standings[i].wins;
+                    else if (row.ranks.at(i) == worstRank && worstRank > 1)
+                        ++standings[i].losses;
                 }
             }
-            out.setFieldWidth(0);
+
+            if (options.sortOrder != OutputOrder)
+                computeSortKeys(&row, options.sortOrder);
+            comparison.rows += row;
+        }
+    }
+
+    if (options.sortOrder != OutputOrder)
+        qStableSort(comparison.rows.begin(), comparison.rows.end(), ComparisonRow::GreaterThan());
+    if (options.top > 0)
+        comparison.rows = comparison.rows.mid(0, options.top);
+
+    return comparison;
+}
+
+static void printComparison(const Options &options, const Comparison &comparison)
+{
+    const bool diffMode = options.diffMode;
+    const QStringList labels = options.cmpLabels();
+
+    QTextStream out(stdout);
+
+    const BenchmarkResult *previousRefResult = 0;
+    foreach (const ComparisonRow &row, comparison.rows) {
+        if (row.refResult != previousRefResult) {
             out << "\n";
+            out.setFieldWidth(20);
+            out.setFieldAlignment(QTextStream::AlignLeft);
+            out << (row.refResult->function + "()");
+            out.setFieldWidth(0);
+            out << row.refResult->tag << "\n";
+            previousRefResult = row.refResult;
         }
+
+        out << "    ";
+        out.setFieldWidth(9);
+        out.setFieldAlignment(QTextStream::AlignLeft);
+        out << row.metric;
+
+        out.setFieldAlignment(QTextStream::AlignRight);
+        for (int i = 0; i < row.cmpMetricResults.count(); ++i) {
+            MetricResult *cmpMetricResult = row.cmpMetricResults.at(i);
+            out.setFieldWidth(0);
+            if (cmpMetricResult && row.zeroReference) {
+                out << valueString(-1, ZeroReference);
+                if (options.matrix)
+                    out << QString(" #%1").arg(row.ranks.at(i));
+            } else if (cmpMetricResult) {
+                const qreal cmpValue = row.cmpValues.at(i);
+                qreal cmpPercentage = (cmpValue / row.refValue) * 100;
+                const ValueMode valueMode = classify(cmpPercentage, row.metric, row.threshold);
+                if (diffMode)
+                    cmpPercentage = cmpPercentage - 100;
+                out << valueString(cmpPercentage, valueMode);
+                if (options.spread)
+                    out << spreadString(cmpMetricResult->samples, cmpValue);
+                if (options.matrix)
+                    out << QString(" #%1").arg(row.ranks.at(i));
+            } else {
+                out << valueString(-1, NotFound);
+            }
+        }
+        out.setFieldWidth(0);
+        if (options.matrix)
+            out << winnerString(row.cmpValues, row.ranks, row.metric, labels);
+        if (row.noise) {
+            out << QString("  [noise %1%]").arg(row.noise->noiseFloor() * 100, 0, 'f', 1);
+            if (row.noise->quarantined)
+                out << " (quarantined)";
+        }
+        out << "\n";
+    }
+
+    if (options.summary) {
+        out << "\nSummary: geometric mean of ratios [95% confidence interval] "
+               "+better -worse =unchanged\n";
+        foreach (QString function, comparison.summaryFunctions) {
+            out << "\n" << function << "()\n";
+            printSummaries(out, comparison.functionSummaries.value(function), diffMode, options.threshold);
+        }
+        out << "\n(all functions)\n";
+        printSummaries(out, comparison.suiteSummaries, diffMode, options.threshold);
+    }
+
+    if (options.matrix) {
+        out << "\nStandings: rows won, rows lost, mean rank, "
+               "geometric mean of ratios [95% confidence interval]\n";
+        printStandings(out, comparison.metricStandings, labels);
     }
 }
 
-static void parseArguments(QStringList &refFiles, QList<QStringList> &cmpFilesList, bool &diffMode)
+// Sorts the comparison table by the clicked column, toggling between ascending and
+// descending order. Cells may carry a numeric sort key.
+static const char *sortTableScript =
+    "<script type=\"text/javascript\">\n"
+    "function sortComparison(column)\n"
+    "{\n"
+    "    var table = document.getElementById(\"comparison\");\n"
+    "    var ascending = !(table.sortColumn == column && table.ascending);\n"
+    "    var rows = [];\n"
+    "    for (var i = 1; i < table.rows.length; ++i)\n"
+    "        rows.push(table.rows[i]);\n"
+    "    rows.sort(function(a, b) {\n"
+    "        var x = a.cells[column].getAttribute(\"sortkey\") || a.cells[column].innerHTML;\n"
+    "        var y = b.cells[column].getAttribute(\"sortkey\") || b.cells[column].innerHTML;\n"
+    "        var nx = parseFloat(x), ny = parseFloat(y);\n"
+    "        var result = (!isNaN(nx) && !isNaN(ny)) ? nx - ny : (x < y ? -1 : (x > y ? 1 : 0));\n"
+    "        return ascending ? result : -result;\n"
+    "    });\n"
+    "    for (var i = 0; i < rows.length; ++i)\n"
+    "        rows[i].parentNode.appendChild(rows[i]);\n"
+    "    table.sortColumn = column;\n"
+    "    table.ascending = ascending;\n"
+    "}\n"
+    "</script>\n";
+
+static QList<QByteArray> htmlComparisonTable(const Options &options, const Comparison &comparison)
 {
-    diffMode = false;
-    QStringList args = qApp->arguments();
-    args.removeFirst();
-    QStringList cmpFiles;
-    enum { AddRefFile, AddCmpFile, None } state = None;
-    foreach (QString arg, args) {
-        if (arg == "-ref") {
-            if (state == AddCmpFile && !cmpFiles.isEmpty()) {
-                cmpFilesList << cmpFiles;
-                cmpFiles.clear();
+    const QStringList labels = options.cmpLabels();
+    QList<QByteArray> output;
+    output += sortTableScript;
+
+    QStringList headers = QStringList() << "Function" << "Tag" << "Metric" << "Reference";
+    foreach (QString label, labels)
+        headers << label;
+    QByteArray header = "<table id=\"comparison\" border=\"1\" cellspacing=\"0\" cellpadding=\"3\">\n<tr>";
+    for (int i = 0; i < headers.count(); ++i)
+        header += QString("<th onclick=\"sortComparison(%1)\">%2</th>").arg(i).arg(headers.at(i).toHtmlEscaped()).toLocal8Bit();
+    output += header + "</tr>\n";
+
+    foreach (const ComparisonRow &row, comparison.rows) {
+        QString line = QString("<tr><td>%1()</td><td>%2</td><td>%3</td><td>%4</td>")
+            .arg(row.refResult->function.toHtmlEscaped()).arg(row.refResult->tag.toHtmlEscaped())
+            .arg(row.metric.toHtmlEscaped()).arg(row.refValue);
+        for (int i = 0; i < row.cmpMetricResults.count(); ++i) {
+            if (!row.cmpMetricResults.at(i)) {
+                line += "<td sortkey=\"-1\">(not found)</td>";
+                continue;
             }
-            state = AddRefFile;
-        } else if (arg == "-cmp") {
-            if (state == AddCmpFile && !cmpFiles.isEmpty()) {
-                cmpFilesList << cmpFiles;
-                cmpFiles.clear();
+            if (row.zeroReference) {
+                line += "<td sortkey=\"-1\">(zero reference)</td>";
+                continue;
             }
-            state = AddCmpFile;
+            const qreal percentage = row.cmpValues.at(i) / row.refValue * 100;
+            const ValueMode valueMode = classify(percentage, row.metric, row.threshold);
+            const char *color = valueMode == Better ? "green" : (valueMode == Worse ? "red" : "black");
+            line += QString("<td sortkey=\"%1\" style=\"color:%2\">%3%</td>")
+                .arg(percentage).arg(color)
+                .arg(options.diffMode ? percentage - 100 : percentage, 0, 'f', 1);
+        }
+        output += line.toLocal8Bit() + "</tr>\n";
+    }
+    output += "</table>\n";
+    return output;
+}
+
+// Writes the values in \a seriesValues to a new results table and renders it with the
+// chart template. \a chartId must be unique within the report.
+static QList<QByteArray> htmlChart(
+    const QString &chartId, const QString &title, ChartType chartType,
+    const QStringList &seriesNames, const QHash<QString, QList<QPair<QString, qreal> > > &seriesValues)
+{
+    TempTable table(resultsTable);
+    DataBaseWriter writer;
+    writer.tableName = table.name();
+    writer.testCaseName = chartId;
+    writer.chartTitle = title;
+    writer.chartType = chartType;
+    foreach (QString seriesName, seriesNames) {
+        QPair<QString, qreal> value;
+        foreach (value, seriesValues.value(seriesName))
+            writer.addResult(seriesName, value.first, QString::number(value.second));
+    }
+
+    ReportGenerator reportGenerator;
+    return reportGenerator.writeChart(table.name(), false);
+}
+
+static QList<QByteArray> htmlComparisonCharts(const Options &options, const Comparison &comparison)
+{
+    const QStringList labels = options.cmpLabels();
+
+    QStringList functions;
+    QHash<QString, QList<const ComparisonRow *> > functionRows;
+    foreach (const ComparisonRow &row, comparison.rows) {
+        if (!functionRows.contains(row.refResult->function))
+            functions += row.refResult->function;
+        functionRows[row.refResult->function] += &row;
+    }
+
+    QList<QByteArray> output;
+    foreach (QString function, functions) {
+        typedef QHash<QString, QList<QPair<QString, qreal> > > SeriesValues;
+
+        // Ratio to the reference of every row, one series per set of comparable results.
+        SeriesValues ratios;
+        foreach (const ComparisonRow *row, functionRows.value(function)) {
+            const QString index = row->refResult->tag.isEmpty() ? row->metric : row->refResult->tag + " " + row->metric;
+            for (int i = 0; i < labels.count(); ++i) {
+                const qreal ratio = row->cmpMetricResults.at(i) && !row->zeroReference
+                    ? row->cmpValues.at(i) / row->refValue * 100 : 0;
+                ratios[labels.at(i)] += qMakePair(index, ratio);
+            }
+        }
+        output += htmlChart(function + "-ratio", "ratio to reference (%)", BarChart, labels, ratios);
+
+        // Reference and comparable values overlaid for each "<series>--<index>" series,
+        // one chart per metric.
+        QStringList metrics;
+        QHash<QString, QStringList> seriesNames;
+        QHash<QString, SeriesValues> overlays;
+        foreach (const ComparisonRow *row, functionRows.value(function)) {
+            const QString tag = row->refResult->tag;
+            if (!tag.contains("--"))
+                continue;
+            const QString series = tag.section("--", 0, 0);
+            const QString index = tag.section("--", 1);
+            if (!overlays.contains(row->metric))
+                metrics += row->metric;
+            SeriesValues &values = overlays[row->metric];
+            QStringList &names = seriesNames[row->metric];
+
+            QStringList rowSeriesNames = QStringList() << "ref " + series;
+            QList<qreal> rowValues = QList<qreal>() << row->refValue;
+            for (int i = 0; i < labels.count(); ++i) {
+                if (!row->cmpMetricResults.at(i))
+                    continue;
+                rowSeriesNames << labels.at(i) + " " + series;
+                rowValues << row->cmpValues.at(i);
+            }
+            for (int i = 0; i < rowSeriesNames.count(); ++i) {
+                if (!names.contains(rowSeriesNames.at(i)))
+                    names += rowSeriesNames.at(i);
+                values[rowSeriesNames.at(i)] += qMakePair(index, rowValues.at(i));
+            }
+        }
+        foreach (QString metric, metrics) {
+            output += htmlChart(function + "-" + metric, metric + ", reference and comparable results",
+                                LineChart, seriesNames.value(metric), overlays.value(metric));
+        }
+    }
+    return output;
+}
+
+static void writeHtmlReport(const Options &options, const Comparison &comparison)
+{
+    // The charts are rendered from temporary tables; use the results database if one is
+    // open already, otherwise an in-memory one.
+    if (!QSqlDatabase::database().isOpen())
+        openDataBase(":memory:");
+
+    QList<QByteArray> description;
+    description += QString("<p>%1 rows compared against the reference.</p>\n")
+        .arg(comparison.rows.count()).toLocal8Bit();
+    description += htmlComparisonTable(options, comparison);
+
+    ReportGenerator reportGenerator;
+    reportGenerator.writePage(options.htmlFile, "Benchmark comparison", description,
+                              htmlComparisonCharts(options, comparison));
+}
+
+static NoiseModel loadNoiseModel(const Options &options)
+{
+    if (options.noiseDataBase.isEmpty())
+        return NoiseModel();
+    if (options.noiseDataBase != options.refSelection.dataBase)
+        openResultsDataBase(options.noiseDataBase);
+    return computeNoiseModel("Results", options.quarantineThreshold / 100);
+}
+
+static void printBenchmarkResults(const Options &options)
+{
+    BenchmarkResults *refResults = new BenchmarkResults;
+    BenchmarkResultsList cmpResultsList;
+
+    // Merge ...
+
+    if (!options.refSelection.dataBase.isEmpty()) {
+        openResultsDataBase(options.refSelection.dataBase);
+        mergeDataBaseResults(options.refSelection, refResults);
+    }
+    QList<QStringList> fileSets;
+    fileSets << options.refFiles;
+    foreach (QStringList paths, options.cmpFilesList)
+        fileSets << resultFiles(paths);
+    cmpResultsList = parseBenchmarkResultSets(fileSets);
+    mergeBenchmarkResults(cmpResultsList.takeFirst(), refResults);
+
+    const NoiseModel noiseModel = loadNoiseModel(options);
+
+    // Compare and print ...
+
+    const Comparison comparison = compareBenchmarkResults(options, refResults, cmpResultsList, noiseModel);
+    printComparison(options, comparison);
+    if (!options.htmlFile.isEmpty())
+        writeHtmlReport(options, comparison);
+}
+
+// Keeps the parsed results of every -cmp file and redoes the comparison when files change,
+// parsing only the files that were added or modified since the last update.
+class ComparisonWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    ComparisonWatcher(const Options &options, BenchmarkResults *refResults, const NoiseModel &noiseModel);
+    ~ComparisonWatcher();
+
+public slots:
+    void update();
+
+private slots:
+    void scheduleUpdate();
+
+private:
+    struct ParsedFile {
+        QDateTime lastModified;
+        qint64 size;
+        BenchmarkResults *bmResults;
+    };
+
+    void watchPaths();
+
+    Options m_options;
+    BenchmarkResults *m_refResults;
+    NoiseModel m_noiseModel;
+    QFileSystemWatcher m_watcher;
+    QTimer m_timer;
+    QHash<QString, ParsedFile> m_parsedFiles;
+    bool m_updated;
+};
+
+ComparisonWatcher::ComparisonWatcher(const Options &options, BenchmarkResults *refResults, const NoiseModel &noiseModel)
+    : m_options(options), m_refResults(refResults), m_noiseModel(noiseModel), m_updated(false)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(500);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(update()));
+    connect(&m_watcher, SIGNAL(fileChanged(QString)), this, SLOT(scheduleUpdate()));
+    connect(&m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(scheduleUpdate()));
+}
+
+ComparisonWatcher::~ComparisonWatcher()
+{
+    foreach (const ParsedFile &parsedFile, m_parsedFiles)
+        deleteBenchmarkResults(parsedFile.bmResults);
+    deleteBenchmarkResults(m_refResults);
+}
+
+void ComparisonWatcher::scheduleUpdate()
+{
+    m_timer.start();
+}
+
+// Files that are replaced rather than written in place drop out of the watcher, and new
+// files in watched directories are not watched yet, so this is redone on every update.
+void ComparisonWatcher::watchPaths()
+{
+    QStringList paths;
+    foreach (QStringList setPaths, m_options.cmpFilesList)
+        paths += setPaths + resultFiles(setPaths);
+
+    const QStringList watched = m_watcher.files() + m_watcher.directories();
+    foreach (QString path, paths) {
+        if (!watched.contains(path) && QFileInfo(path).exists())
+            m_watcher.addPath(path);
+    }
+}
+
+void ComparisonWatcher::update()
+{
+    QList<QStringList> fileSets;
+    QSet<QString> currentFiles;
+    QStringList changedFiles;
+    foreach (QStringList paths, m_options.cmpFilesList) {
+        const QStringList files = resultFiles(paths);
+        fileSets << files;
+        foreach (QString file, files) {
+            currentFiles.insert(file);
+            const QFileInfo info(file);
+            const ParsedFile parsedFile = m_parsedFiles.value(file);
+            if ((!m_parsedFiles.contains(file) || parsedFile.lastModified != info.lastModified()
+                 || parsedFile.size != info.size()) && !changedFiles.contains(file))
+                changedFiles += file;
+        }
+    }
+
+    int removedFiles = 0;
+    foreach (QString file, m_parsedFiles.keys()) {
+        const bool removed = !currentFiles.contains(file);
+        if (removed || changedFiles.contains(file))
+            deleteBenchmarkResults(m_parsedFiles.take(file).bmResults);
+        if (removed)
+            ++removedFiles;
+    }
+
+    watchPaths();
+    if (m_updated && changedFiles.isEmpty() && removedFiles == 0)
+        return;
+    m_updated = true;
+
+    const QList<BenchmarkResults *> partialResultsList =
+        QtConcurrent::blockingMapped(changedFiles, parseBenchmarkResults);
+    for (int i = 0; i < changedFiles.count(); ++i) {
+        const QFileInfo info(changedFiles.at(i));
+        ParsedFile parsedFile;
+        parsedFile.lastModified = info.lastModified();
+        parsedFile.size = info.size();
+        parsedFile.bmResults = partialResultsList.at(i);
+        m_parsedFiles.insert(changedFiles.at(i), parsedFile);
+    }
+
+    // Merging consumes the per-file results, so merge copies of the cached ones.
+    BenchmarkResultsList cmpResultsList;
+    foreach (QStringList files, fileSets) {
+        BenchmarkResults *bmResults = new BenchmarkResults;
+        foreach (QString file, files)
+            mergeBenchmarkResults(copyBenchmarkResults(m_parsedFiles.value(file).bmResults), bmResults);
+        cmpResultsList << bmResults;
+    }
+
+    {
+        QTextStream out(stdout);
+        out << "\n*** " << QTime::currentTime().toString() << ": parsed " << changedFiles.count()
+            << " file(s), " << removedFiles << " file(s) removed\n";
+    }
+
+    const Comparison comparison = compareBenchmarkResults(m_options, m_refResults, cmpResultsList, m_noiseModel);
+    printComparison(m_options, comparison);
+    if (!m_options.htmlFile.isEmpty())
+        writeHtmlReport(m_options, comparison);
+
+    foreach (BenchmarkResults *bmResults, cmpResultsList)
+        deleteBenchmarkResults(bmResults);
+}
+
+// Parses the reference once, then compares again whenever -cmp files change.
+static int watchBenchmarkResults(const Options &options)
+{
+    BenchmarkResults *refResults = new BenchmarkResults;
+    if (!options.refSelection.dataBase.isEmpty()) {
+        openResultsDataBase(options.refSelection.dataBase);
+        mergeDataBaseResults(options.refSelection, refResults);
+    }
+    mergeBenchmarkResults(parseBenchmarkResultSets(QList<QStringList>() << options.refFiles).first(), refResults);
+
+    ComparisonWatcher watcher(options, refResults, loadNoiseModel(options));
+    watcher.update();
+    return qApp->exec();
+}
+
+// The values of one function/tag/metric over a series of runs. Runs without a
+// result for the combination are left out, so runIndexes maps back to the runs.
+struct ResultSeries {
+    QString function;
+    QString tag;
+    QString metric;
+    QList<int> runIndexes;
+    QList<qreal> values;
+};
+
+struct ChangePointAnalysis {
+    typedef QList<ChangePoint> result_type;
+    ChangePointOptions options;
+
+    QList<ChangePoint> operator()(const ResultSeries &series) const {
+        return detectChangePoints(series.values, options);
+    }
+};
+
+static void printChangePoints(const Options &options)
+{
+    QStringList runLabels;
+    BenchmarkResultsList runResultsList;
+
+    // Merge ...
+
+    if (!options.runDataBase.isEmpty()) {
+        openResultsDataBase(options.runDataBase);
+        foreach (QString runLabel, allRunLabels()) {
+            RefSelection selection;
+            selection.label = runLabel;
+            BenchmarkResults *runResults = new BenchmarkResults;
+            mergeDataBaseResults(selection, runResults);
+            runResultsList << runResults;
+            runLabels << runLabel;
+        }
+    }
+    runResultsList += parseBenchmarkResultSets(options.runFilesList);
+    foreach (QStringList runFiles, options.runFilesList)
+        runLabels << QFileInfo(runFiles.first()).fileName();
+
+    // Collect one series per function/tag/metric, in order of first appearance ...
+
+    QList<ResultSeries> seriesList;
+    QHash<QString, int> seriesIndexes;
+    for (int run = 0; run < runResultsList.count(); ++run) {
+        QList<BenchmarkResult *> sortedRunResults(runResultsList.at(run)->values());
+        qSort(sortedRunResults.begin(), sortedRunResults.end(), BenchmarkResult::LessThan());
+        foreach (BenchmarkResult *bmResult, sortedRunResults) {
+            QStringList metrics = bmResult->metricResults.keys();
+            metrics.sort();
+            foreach (QString metric, metrics) {
+                const QString key = bmResult->function + bmResult->tag + "/" + metric;
+                if (!seriesIndexes.contains(key)) {
+                    seriesIndexes.insert(key, seriesList.count());
+                    ResultSeries series;
+                    series.function = bmResult->function;
+                    series.tag = bmResult->tag;
+                    series.metric = metric;
+                    seriesList += series;
+                }
+                ResultSeries &series = seriesList[seriesIndexes.value(key)];
+                series.runIndexes += run;
+                series.values += bmResult->metricResults.value(metric)->estimate(options.estimator);
+            }
+        }
+    }
+
+    // Analyze ...
+
+    ChangePointAnalysis analysis;
+    analysis.options.penalty = options.penalty;
+    const QList<QList<ChangePoint> > changePointsList =
+        QtConcurrent::blockingMapped(seriesList, analysis);
+
+    // Print ...
+
+    QTextStream out(stdout);
+    out << "Change points in " << seriesList.count() << " series over "
+        << runResultsList.count() << " runs\n";
+
+    QString previousFuncTag;
+    for (int i = 0; i < seriesList.count(); ++i) {
+        const ResultSeries &series = seriesList.at(i);
+        foreach (const ChangePoint &changePoint, changePointsList.at(i)) {
+            if (changePoint.confidence < options.confidence)
+                continue;
+
+            const QString funcTag = series.function + series.tag;
+            if (funcTag != previousFuncTag) {
+                out << "\n";
+                out.setFieldWidth(20);
+                out.setFieldAlignment(QTextStream::AlignLeft);
+                out << (series.function + "()");
+                out.setFieldWidth(0);
+                out << series.tag << "\n";
+                previousFuncTag = funcTag;
+            }
+
+            const int run = series.runIndexes.at(changePoint.index);
+            const qreal percentage = changePoint.before == 0 ? 0 : (changePoint.after / changePoint.before) * 100;
+            out << "    ";
+            out.setFieldWidth(9);
+            out.setFieldAlignment(QTextStream::AlignLeft);
+            out << series.metric;
+            out.setFieldWidth(0);
+            out << valueString(options.diffMode ? percentage - 100 : percentage,
+                               changePoint.before == 0 ? ZeroReference
+                                                       : classify(percentage, series.metric, options.threshold))
+                << QString("  run %1 (%2): %3 -> %4, confidence %5%")
+                   .arg(run).arg(runLabels.at(run))
+                   .arg(changePoint.before).arg(changePoint.after)
+                   .arg(changePoint.confidence * 100, 0, 'f', 1)
+                << "\n";
+        }
+    }
+}
+
+static bool parseArguments(Options &options)
+{
+    QStringList args = qApp->arguments();
+    args.removeFirst();
+    QStringList files;
+    enum { AddRefFile, AddCmpFile, AddRunFile, None } state = None;
+    for (int i = 0; i < args.count(); ++i) {
+        const QString arg = args.at(i);
+        const bool hasValue = i + 1 < args.count();
+        if (arg == "-ref" || arg == "-cmp" || arg == "-run") {
+            if (state == AddCmpFile && !files.isEmpty())
+                options.cmpFilesList << files;
+            else if (state == AddRunFile && !files.isEmpty())
+                options.runFilesList << files;
+            files.clear();
+            if (arg == "-ref")
+                state = AddRefFile;
+            else if (arg == "-cmp")
+                state = AddCmpFile;
+            else
+                state = AddRunFile;
         } else if (arg == "-diff") {
-            diffMode = true;
+            options.diffMode = true;
+        } else if (arg == "-summary") {
+            options.summary = true;
+        } else if (arg == "-matrix") {
+            options.matrix = true;
+        } else if (arg == "-name") {
+            // Names label a -cmp set; anywhere else it would be taken for a file.
+            if (!hasValue || state != AddCmpFile)
+                return false;
+            options.cmpNames.insert(options.cmpFilesList.count(), args.at(++i));
+        } else if (arg == "-polarity") {
+            metricPolarity = true;
+        } else if (arg == "-spread") {
+            options.spread = true;
+        } else if (arg == "-estimator" && hasValue) {
+            const QString estimator = args.at(++i);
+            if (estimator == "median")
+                options.estimator = Median;
+            else if (estimator == "min")
+                options.estimator = Minimum;
+            else if (estimator == "mean")
+                options.estimator = Mean;
+            else if (estimator == "first")
+                options.estimator = First;
+            else
+                return false;
+        } else if (arg == "-threshold" && hasValue) {
+            bool ok;
+            options.threshold = args.at(++i).toDouble(&ok);
+            if (!ok || options.threshold < 0)
+                return false;
+        } else if ((arg == "-function" || arg == "-tag" || arg == "-metric") && hasValue) {
+            const QRegExp filter(args.at(++i));
+            if (!filter.isValid())
+                return false;
+            if (arg == "-function")
+                options.functionFilter = filter;
+            else if (arg == "-tag")
+                options.tagFilter = filter;
+            else
+                options.metricFilter = filter;
+        } else if (arg == "-sort" && hasValue) {
+            const QString sortOrder = args.at(++i);
+            if (sortOrder == "delta")
+                options.sortOrder = SortByDelta;
+            else if (sortOrder == "ratio")
+                options.sortOrder = SortByRatio;
+            else if (sortOrder == "significance")
+                options.sortOrder = SortBySignificance;
+            else
+                return false;
+        } else if (arg == "-top" && hasValue) {
+            bool ok;
+            options.top = args.at(++i).toInt(&ok);
+            if (!ok || options.top < 1)
+                return false;
+        } else if (arg == "-watch") {
+            options.watch = true;
+        } else if (arg == "-html" && hasValue) {
+            options.htmlFile = args.at(++i);
+        } else if (arg == "-noisedb" && hasValue) {
+            options.noiseDataBase = args.at(++i);
+        } else if (arg == "-quarantine" && hasValue) {
+            bool ok;
+            options.quarantineThreshold = args.at(++i).toDouble(&ok);
+            if (!ok || options.quarantineThreshold <= 0)
+                return false;
+        } else if (arg == "-changepoints") {
+            options.changePoints = true;
+        } else if (arg == "-rundb" && hasValue) {
+            options.runDataBase = args.at(++i);
+        } else if (arg == "-confidence" && hasValue) {
+            bool ok;
+            options.confidence = args.at(++i).toDouble(&ok);
+            if (!ok || options.confidence < 0 || options.confidence > 1)
+                return false;
+        } else if (arg == "-penalty" && hasValue) {
+            bool ok;
+            options.penalty = args.at(++i).toDouble(&ok);
+            if (!ok || options.penalty <= 0)
+                return false;
+        } else if (arg == "-refdb" && hasValue) {
+            options.refSelection.dataBase = args.at(++i);
+        } else if (arg == "-refversion" && hasValue) {
+            options.refSelection.version = args.at(++i);
+        } else if (arg == "-reflabel" && hasValue) {
+            options.refSelection.label = args.at(++i);
+        } else if (arg == "-reflast" && hasValue) {
+            bool ok;
+            options.refSelection.lastRuns = args.at(++i).toInt(&ok);
+            if (!ok || options.refSelection.lastRuns < 1)
+                return false;
         } else {
             if (state == AddRefFile) {
-                refFiles << arg;
-            } else if (state == AddCmpFile) {
-                cmpFiles << arg;
+                options.refFiles << arg;
+            } else if (state == AddCmpFile || state == AddRunFile) {
+                files << arg;
             }
         }
     }
-    if (!cmpFiles.isEmpty())
-        cmpFilesList << cmpFiles;
+    if (state == AddCmpFile && !files.isEmpty())
+        options.cmpFilesList << files;
+    else if (state == AddRunFile && !files.isEmpty())
+        options.runFilesList << files;
+
+    if (options.changePoints)
+        return !(options.runFilesList.isEmpty() && options.runDataBase.isEmpty());
+
+    return !(options.refFiles.isEmpty() && options.refSelection.dataBase.isEmpty())
+        && !options.cmpFilesList.isEmpty();
 }
 
 static void printUsage()
 {
     qDebug() << "usage:" << qApp->arguments().first().toStdString().data() <<
-        "[-diff] "
-        "-ref <ref file 1> [<ref file 2> ...] "
-        "-cmp <cmp file 1.1> [<cmp file 1.2> ...] "
-        "[-cmp <cmp file 2.1> [<cmp file 2.2> ...] ...]";
+        "[-diff] [-summary] [-matrix] [-spread] [-polarity] [-threshold <percent>] "
+        "[-estimator median|min|mean|first] "
+        "[-function <regexp>] [-tag <regexp>] [-metric <regexp>] "
+        "[-sort delta|ratio|significance] [-top <N>] "
+        "[-noisedb <database> [-quarantine <percent>]] [-html <file>] [-watch] "
+        "{-ref <ref file 1> [<ref file 2> ...] | "
+        "-refdb <database> [-refversion <version> | -reflabel <label> | -reflast <N>]} "
+        "-cmp [-name <label>] <cmp file or dir 1.1> [<cmp file or dir 1.2> ...] "
+        "[-cmp [-name <label>] <cmp file or dir 2.1> [<cmp file or dir 2.2> ...] ...]";
+    qDebug() << "      " << qApp->arguments().first().toStdString().data() <<
+        "-changepoints [-diff] [-polarity] [-threshold <percent>] [-estimator median|min|mean|first] "
+        "[-confidence <0..1>] [-penalty <factor>] "
+        "{-rundb <database> | -run <run file 1.1> [<run file 1.2> ...] "
+        "-run <run file 2.1> [<run file 2.2> ...] ...}";
 }
 
 int main(int argc, char **argv)
 {
     QCoreApplication app(argc, argv);
 
-    QStringList refFiles;
-    QList<QStringList> cmpFilesList;
-    bool diffMode;
-
-    parseArguments(refFiles, cmpFilesList, diffMode);
-    if (refFiles.isEmpty() || cmpFilesList.isEmpty()) {
+    Options options;
+    if (!parseArguments(options)) {
         printUsage();
         return 1;
     }
 
-    printBenchmarkResults(refFiles, cmpFilesList, diffMode);
+    if (options.changePoints)
+        printChangePoints(options);
+    else if (options.watch)
+        return watchBenchmarkResults(options);
+    else
+        printBenchmarkResults(options);
     
     return 0;
 }
+
+#include "main.moc"
@@ -1,8 +1,9 @@
 include (../../benchlib.pri)
-QT += sql xml widgets
+QT += sql xml widgets network
 
 DEPENDPATH += .
 INCLUDEPATH += .
 TARGET = generatereport
 # Input
-SOURCES += main.cpp
+HEADERS += ../../src/reportserver.h
+SOURCES += main.cpp ../../src/reportserver.cpp
@@ -24,29 +24,200 @@
 #include <QtSql>
 #include <database.h>
 #include <reportgenerator.h>
- 
+#include <reportserver.h>
+
+// Watches a drop directory for QTestLib XML result files and loads new ones into the
+// results database, rendering only the test cases that got results again.
+// Files are ingested once their size has stayed the same for one scan, so files that
+// are still being copied in are not loaded half written. Changes are batched: a scan
+// runs a moment after the last change, and all files it finds go in one transaction.
+class ResultIngester : public QObject
+{
+    Q_OBJECT
+public:
+    ResultIngester(const QString &directory, const QString &runLabel);
+
+public slots:
+    void ingest();
+
+private slots:
+    void scheduleIngest();
+
+private:
+    QString m_directory;
+    QString m_runLabel;
+    QFileSystemWatcher m_watcher;
+    QTimer m_timer;
+    QHash<QString, qint64> m_pendingSizes;
+    ReportGenerator m_reportGenerator;
+    bool m_reportsWritten;
+};
+
+ResultIngester::ResultIngester(const QString &directory, const QString &runLabel)
+    : m_directory(directory), m_runLabel(runLabel), m_reportsWritten(false)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(1000);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(ingest()));
+    connect(&m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(scheduleIngest()));
+    m_watcher.addPath(directory);
+}
+
+// Adds the test cases that have results in the rows \a firstRow to \a lastRow.
+static void addTestCases(QList<QPair<QString, QString> > *testCases, qint64 firstRow, qint64 lastRow)
+{
+    QSqlQuery affected;
+    affected.prepare("SELECT DISTINCT QtVersion, TestCaseName FROM Results WHERE rowid >= :FirstRow AND rowid <= :LastRow");
+    affected.bindValue(":FirstRow", firstRow);
+    affected.bindValue(":LastRow", lastRow);
+    execQuery(affected);
+    while (affected.next()) {
+        const QPair<QString, QString> testCase = qMakePair(affected.value(0).toString(), affected.value(1).toString());
+        if (testCases->contains(testCase) == false)
+            *testCases += testCase;
+    }
+}
+
+void ResultIngester::scheduleIngest()
+{
+    m_timer.start();
+}
+
+void ResultIngester::ingest()
+{
+    QList<QFileInfo> files;
+    bool incomplete = false;
+    foreach (QFileInfo file, QDir(m_directory).entryInfoList(QStringList() << "*.xml", QDir::Files, QDir::Time | QDir::Reversed)) {
+        if (isIngested(file)) {
+            m_pendingSizes.remove(file.absoluteFilePath());
+            continue;
+        }
+        const QString path = file.absoluteFilePath();
+        if (m_pendingSizes.value(path, -1) != file.size()) {
+            m_pendingSizes.insert(path, file.size());
+            incomplete = true;
+            continue;
+        }
+        m_pendingSizes.remove(path);
+        files += file;
+    }
+    // Look again for the files that may still be growing.
+    if (incomplete)
+        m_timer.start();
+    if (files.isEmpty() && m_reportsWritten)
+        return;
+
+    const QString runLabel = m_runLabel.isEmpty() ? QDateTime::currentDateTime().toString(Qt::ISODate) : m_runLabel;
+
+    // A file that changed since it was ingested replaces the results loaded from it.
+    QList<QPair<QString, QString> > testCases;
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    foreach (const QFileInfo &file, files) {
+        qint64 firstRow;
+        qint64 lastRow;
+        if (ingestedRows(file, &firstRow, &lastRow)) {
+            addTestCases(&testCases, firstRow, lastRow);
+            removeResultRows(firstRow, lastRow);
+        }
+        qDebug() << "Reading xml from" << file.filePath();
+        firstRow = lastResultRow() + 1;
+        loadXml(file.filePath(), file.fileName(), runLabel);
+        lastRow = lastResultRow();
+        addIngestedFile(file, runLabel, firstRow, lastRow);
+        addTestCases(&testCases, firstRow, lastRow);
+    }
+    db.commit();
+
+    // The first reports cover what was in the database already.
+    if (m_reportsWritten == false)
+        addTestCases(&testCases, 0, lastResultRow());
+
+    m_reportGenerator.updateReports(testCases);
+    m_reportsWritten = true;
+}
+
 int main(int argc, char **argv)
 {
     QCoreApplication app(argc, argv);
 
     if (argc < 2) {
-        qDebug() << "Usage: generatereport xml-file [xml-file2 xml-file3 ...]";
+        qDebug() << "Usage: generatereport [-database <file> [-label <run label>]] xml-file [xml-file2 xml-file3 ...]";
+        qDebug() << "       generatereport -database <file> -watch <directory> [-label <run label>]";
+        qDebug() << "       generatereport -database <file> -serve <port> [-bind <address>]";
         return 0;
     }
 
+    // -database keeps the results in a persistent database (which bmcompare
+    // can use as a reference through -refdb), -label names the run the files
+    // belong to. Without -database the results only live for this invocation.
+    // -watch keeps running, ingesting the result files that appear in a directory
+    // (see ResultIngester); each batch is its own run unless -label is given.
+    // -serve answers report requests over HTTP (see ReportServer), on localhost
+    // unless -bind gives another address.
+    QString databaseFile;
+    QString runLabel;
+    QString watchDirectory;
+    int servePort = 0;
+    QHostAddress bindAddress = QHostAddress::LocalHost;
     QStringList files;
     for (int i = 1; i < argc; i++) {
-        QString file = QString::fromLocal8Bit(argv[i]);
-        files += file;
-        qDebug() << "Reading xml from" << file;
+        QString arg = QString::fromLocal8Bit(argv[i]);
+        if (arg == "-database" && i + 1 < argc) {
+            databaseFile = QString::fromLocal8Bit(argv[++i]);
+        } else if (arg == "-label" && i + 1 < argc) {
+            runLabel = QString::fromLocal8Bit(argv[++i]);
+        } else if (arg == "-watch" && i + 1 < argc) {
+            watchDirectory = QString::fromLocal8Bit(argv[++i]);
+        } else if (arg == "-serve" && i + 1 < argc) {
+            servePort = QString::fromLocal8Bit(argv[++i]).toInt();
+        } else if (arg == "-bind" && i + 1 < argc) {
+            bindAddress = QHostAddress(QString::fromLocal8Bit(argv[++i]));
+        } else {
+            files += arg;
+            qDebug() << "Reading xml from" << arg;
+        }
+    }
+
+    if (servePort > 0) {
+        if (databaseFile.isEmpty()) {
+            qDebug() << "-serve needs a -database to serve reports from";
+            return 1;
+        }
+        openResultsDataBase(databaseFile);
+        ReportServer server;
+        if (server.listen(bindAddress, servePort) == false) {
+            qDebug() << "could not listen on" << bindAddress.toString() << servePort << ":" << server.errorString();
+            return 1;
+        }
+        qDebug() << "Serving reports on" << QString("http://%1:%2/").arg(bindAddress.toString()).arg(servePort);
+        return app.exec();
+    }
+
+    if (watchDirectory.isEmpty() == false) {
+        if (databaseFile.isEmpty() || QFileInfo(watchDirectory).isDir() == false) {
+            qDebug() << "-watch needs a directory and a -database to ingest into";
+            return 1;
+        }
+        openResultsDataBase(databaseFile);
+        ResultIngester ingester(watchDirectory, runLabel);
+        ingester.ingest();
+        qDebug() << "Watching" << watchDirectory << "for result files";
+        return app.exec();
     }
 
-    QSqlDatabase db = createDataBase(":memory:");
+    if (runLabel.isEmpty())
+        runLabel = QDateTime::currentDateTime().toString(Qt::ISODate);
+
+    QSqlDatabase db = databaseFile.isEmpty() ? createDataBase(":memory:") : openResultsDataBase(databaseFile);
 
-    loadXml(files);
+    db.transaction();
+    loadXml(files, runLabel);
+    db.commit();
 
     ReportGenerator reportGenerator;
     reportGenerator.writeReports();
     db.close();
 }
 
+#include "main.moc"